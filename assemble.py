@@ -1,6 +1,8 @@
 #!/usr/bin/env python3
 import argparse
+import hashlib
 import os
+import pickle
 import re
 import sys
 import time
@@ -90,6 +92,19 @@ OPCODES = {
     'NIBSWAPX':0x4E,
     'MIXAX':0x4F,
     'LDI':0x50,
+    'BMOV':0x51,  # block move, descriptor = src, dst, len
+    'BFILL':0x52, # block fill with A, descriptor = dst, len
+    'MUL':0x53,   # A:X = A * X
+    'DIV':0x54,   # A:X = A:X / [abs]
+    'MOD':0x55,   # A:X = A:X % [abs]
+    'ADD16':0x56, # A:X += word at abs
+    'SUB16':0x57, # A:X -= word at abs
+    'DADD':0x58,  # BCD string add, descriptor = dst, src, len
+    'DSUB':0x59,  # BCD string subtract, descriptor = dst, src, len
+    'TAS':0x5A,   # atomic test-and-set bit 7 of [abs]
+    'CAS':0x5B,   # atomic compare [abs] with A, store X if equal
+    'FENCE':0x5C, # memory fence
+    'HALT':0xFF,
 
 
 
@@ -162,7 +177,40 @@ SIZES = {
 0x4D:1,
 0x4E:1,
 0x4F:1,
-0x50:3
+0x50:3,
+0x51:3, # opcode + 16-bit descriptor address
+0x52:3,
+0x53:1,
+0x54:3,
+0x55:3,
+0x56:3,
+0x57:3,
+0x58:3,
+0x59:3,
+0x5A:3,
+0x5B:3,
+0x5C:1,
+0xFF:1,
+}
+
+# rel8 branch opcodes; their operand is encoded relative to the next instruction
+REL_OPS = {0x0B, 0x12, 0x14, 0x15, 0x18, 0x25, 0x2B, 0x3E, 0x3F}
+
+# Base cycle counts, mirroring CYCLES[] in src/cpu.cpp (unlisted opcodes cost 0)
+CYCLES = {
+    0x00: 2, 0x01: 4, 0x02: 5, 0x03: 2, 0x04: 2, 0x05: 2, 0x06: 2, 0x07: 2,
+    0x08: 2, 0x09: 4, 0x0A: 5, 0x0B: 3, 0x0C: 4, 0x0D: 4, 0x0E: 4, 0x0F: 4,
+    0x10: 6, 0x11: 4, 0x12: 5, 0x13: 4, 0x14: 3, 0x15: 3, 0x16: 3, 0x17: 4,
+    0x18: 4, 0x19: 3, 0x1A: 3, 0x1B: 3, 0x1C: 3, 0x1D: 2, 0x1E: 2, 0x1F: 2,
+    0x20: 2, 0x21: 2, 0x22: 2, 0x23: 2, 0x24: 2, 0x25: 5, 0x26: 4, 0x27: 3,
+    0x28: 2, 0x29: 2, 0x2A: 4, 0x2B: 3, 0x2C: 3, 0x2D: 3, 0x2E: 3, 0x2F: 3,
+    0x30: 2, 0x31: 2, 0x32: 2, 0x33: 2, 0x34: 2, 0x35: 2, 0x36: 3, 0x37: 2,
+    0x38: 2, 0x39: 2, 0x3A: 2, 0x3B: 2, 0x3C: 4, 0x3D: 4, 0x3E: 3, 0x3F: 3,
+    0x40: 6, 0x41: 2, 0x42: 3, 0x43: 2, 0x44: 18, 0x45: 13, 0x46: 16, 0x47: 19,
+    0x48: 6, 0x49: 6, 0x4A: 4, 0x4B: 4, 0x4C: 2, 0x4D: 2, 0x4E: 2, 0x4F: 3,
+    0x51: 6, 0x52: 6, 0x53: 8, 0x54: 12, 0x55: 12, 0x56: 6, 0x57: 6,
+    0x58: 6, 0x59: 6, 0x5A: 6, 0x5B: 7, 0x5C: 3,
+    0xFF: 2,
 }
 
 # ---------------- Utilities ----------------
@@ -197,10 +245,122 @@ def tokenize_operands(s: str):
 def checksum16(bs: bytes) -> int:
     return sum(bs) & 0xFFFF
 
+def is_org(line: str) -> bool:
+    return line.strip().lower().startswith('.org')
+
+def parse_source(text: str) -> list:
+    """Split one source file into ('line'|'include'|'define', line_no, a, b) entries."""
+    entries = []
+    for ln, raw in enumerate(text.splitlines(), 1):
+        line = strip_comment(raw)
+        if not line.strip():
+            continue
+
+        # Includes: %include "file" or include "file"
+        inc_m = re.match(r'^\s*(%include|include)\s+(.+)$', line, re.IGNORECASE)
+        if inc_m:
+            rest = inc_m.group(2).strip()
+            m = re.match(r'^"(.*)"$', rest)
+            if m:
+                inc_path = m.group(1)
+            else:
+                inc_path = rest.split()[0]
+            entries.append(('include', ln, inc_path, None))
+            continue
+
+        # #define NAME VALUE
+        def_m = re.match(r'^\s*#define\s+([A-Za-z_]\w*)\s+(.+)$', line)
+        if def_m:
+            entries.append(('define', ln, def_m.group(1), def_m.group(2).strip()))
+            continue
+
+        # .equ NAME VALUE   OR   .equ NAME, VALUE
+        equ_m = re.match(r'^\s*\.equ\s+([A-Za-z_]\w*)\s*(?:,|\s)\s*(.+)$', line, re.IGNORECASE)
+        if equ_m:
+            entries.append(('define', ln, equ_m.group(1), equ_m.group(2).strip()))
+            continue
+
+        entries.append(('line', ln, line, None))
+    return entries
+
+# ---------------- Build cache ----------------
+
+# Bump whenever encoding changes (instruction sizes, operand forms, new
+# opcodes): cached chunks hold encoded bytes and are otherwise reused as-is.
+CACHE_VERSION = 2
+
+class BuildCache:
+    """
+    On-disk cache for incremental builds.
+
+    Parsed files are keyed on the SHA-1 of their contents. Pass results are
+    keyed on (content hash, chunk number), where a chunk is the run of lines
+    between two includes:
+      - pass 1 keeps the chunk size and its label offsets,
+      - pass 2 keeps the encoded bytes together with the start address and
+        every operand token value they were built from.
+    A chunk is re-encoded only when its text changed or one of the symbols it
+    uses moved, so editing one include rebuilds that include and the chunks
+    that reference its labels, nothing else.
+    """
+
+    def __init__(self, path) -> None:
+        self.path = path
+        self.hits = 0
+        self.misses = 0
+        self.old = {'files': {}, 'pass1': {}, 'pass2': {}}
+        try:
+            with open(path, 'rb') as fh:
+                data = pickle.load(fh)
+            if data.get('version') == CACHE_VERSION:
+                self.old = data
+        except (OSError, EOFError, pickle.UnpicklingError, AttributeError, ValueError):
+            pass
+        # Only entries touched by this build are written back, so the file
+        # never grows past the current set of sources.
+        self.new = {'files': {}, 'pass1': {}, 'pass2': {}}
+
+    def _get(self, table, key):
+        val = self.new[table].get(key)
+        if val is None:
+            val = self.old[table].get(key)
+            if val is not None:
+                self.new[table][key] = val
+        return val
+
+    def parsed(self, digest):
+        return self._get('files', digest)
+
+    def store_parsed(self, digest, entries) -> None:
+        self.new['files'][digest] = entries
+
+    def pass1(self, key):
+        return self._get('pass1', key)
+
+    def store_pass1(self, key, size, labels) -> None:
+        self.new['pass1'][key] = (size, labels)
+
+    def pass2(self, key):
+        return self._get('pass2', key)
+
+    def store_pass2(self, key, start, end, tokens, data) -> None:
+        self.new['pass2'][key] = (start, end, tokens, data)
+
+    def save(self) -> None:
+        self.new['version'] = CACHE_VERSION
+        try:
+            os.makedirs(os.path.dirname(self.path) or '.', exist_ok=True)
+            tmp = self.path + '.tmp'
+            with open(tmp, 'wb') as fh:
+                pickle.dump(self.new, fh, protocol=pickle.HIGHEST_PROTOCOL)
+            os.replace(tmp, self.path)
+        except OSError as e:
+            sys.stderr.write(f"Warning: cannot write build cache {self.path}: {e}\n")
+
 # ---------------- Assembler ----------------
 
 class Assembler:
-    def __init__(self, origin=0x0000, fill=0x00, include_paths=None, cli_defines=None) -> None:
+    def __init__(self, origin=0x0000, fill=0x00, include_paths=None, cli_defines=None, cache=None) -> None:
         self.origin = origin & 0xFFFF
         self.fill = fill & 0xFF
         self.include_paths = include_paths or []
@@ -209,6 +369,9 @@ class Assembler:
         self.lines = []    # list of (file, line_no, text)
         self.segments = [] # list of (addr, bytes)
         self.errors = []
+        self.chunks = []   # list of (cache key, first line, end line)
+        self.cache = cache
+        self.used_tokens = None
 
     # ---------- Preprocessing and loading ----------
 
@@ -238,56 +401,89 @@ class Assembler:
             return
         _seen.add(filename)
         try:
-            with open(filename, 'r', encoding='utf-8') as fh:
-                raw_lines = fh.readlines()
+            with open(filename, 'rb') as fh:
+                data = fh.read()
         except OSError as e:
             self.errors.append(f"Cannot open {filename}: {e}")
             return
 
-        for ln, raw in enumerate(raw_lines, 1):
-            line = strip_comment(raw)
-            if not line.strip():
-                continue
+        digest = hashlib.sha1(data).hexdigest()
+        entries = self.cache.parsed(digest) if self.cache else None
+        if entries is None:
+            entries = parse_source(data.decode('utf-8'))
+            if self.cache:
+                self.cache.store_parsed(digest, entries)
 
-            # Includes: %include "file" or include "file"
-            inc_m = re.match(r'^\s*(%include|include)\s+(.+)$', line, re.IGNORECASE)
-            if inc_m:
-                rest = inc_m.group(2).strip()
-                m = re.match(r'^"(.*)"$', rest)
-                if m:
-                    inc_path = m.group(1)
-                else:
-                    inc_path = rest.split()[0]
-                resolved = self.resolve_include(inc_path, filename)
+        # Every include or .org splits the file into another chunk; chunks are
+        # the unit that pass 1 and pass 2 results are cached on.
+        chunk_no = 0
+        chunk_start = len(self.lines)
+        for kind, ln, a, b in entries:
+            if kind == 'line':
+                if is_org(a) and len(self.lines) > chunk_start:
+                    # .org starts a new chunk so the code after it can be
+                    # cached independently of where the previous code ended.
+                    self.chunks.append(((digest, chunk_no), chunk_start, len(self.lines)))
+                    chunk_no += 1
+                    chunk_start = len(self.lines)
+                self.lines.append((filename, ln, a))
+            elif kind == 'define':
+                self.defines[a] = b
+            else:
+                self.chunks.append(((digest, chunk_no), chunk_start, len(self.lines)))
+                chunk_no += 1
+                resolved = self.resolve_include(a, filename)
                 if not resolved:
-                    self.errors.append(f"{filename}:{ln}: include not found: {inc_path}")
+                    self.errors.append(f"{filename}:{ln}: include not found: {a}")
                 else:
                     self.load_file(resolved, _seen=_seen)
-                continue
+                chunk_start = len(self.lines)
+        self.chunks.append(((digest, chunk_no), chunk_start, len(self.lines)))
 
-            # #define NAME VALUE
-            def_m = re.match(r'^\s*#define\s+([A-Za-z_]\w*)\s+(.+)$', line)
-            if def_m:
-                name = def_m.group(1)
-                val = def_m.group(2).strip()
-                self.defines[name] = val
-                continue
+    # ---------- Pass 1: label addresses ----------
+
+    def iter_chunks(self):
+        # Sources fed in without load_file (stdin) form a single uncached chunk.
+        if not self.chunks:
+            return [(None, 0, len(self.lines))]
+        return self.chunks
 
-            # .equ NAME VALUE   OR   .equ NAME, VALUE
-            equ_m = re.match(r'^\s*\.equ\s+([A-Za-z_]\w*)\s*(?:,|\s)\s*(.+)$', line, re.IGNORECASE)
-            if equ_m:
-                name = equ_m.group(1)
-                val = equ_m.group(2).strip()
-                self.defines[name] = val
+    def pass1(self) -> None:
+        pc = self.origin
+        for key, start, end in self.iter_chunks():
+            if start < end and is_org(self.lines[start][2]):
+                # A leading .org is replayed every build; the rest of the chunk is relative to it.
+                pc, _, _ = self.pass1_lines(self.lines[start:start + 1], pc)
+                start += 1
+            cached = self.cache.pass1(key) if (self.cache and key) else None
+            if cached is not None:
+                size, offsets = cached
+                for label, off, file, ln in offsets:
+                    self.define_label(label, (pc + off) & 0xFFFF, file, ln)
+                pc += size
                 continue
 
-            self.lines.append((filename, ln, line))
+            errors = len(self.errors)
+            chunk_pc = pc
+            pc, offsets, relocatable = self.pass1_lines(self.lines[start:end], pc)
+            if self.cache and key and relocatable and len(self.errors) == errors:
+                self.cache.store_pass1(key, pc - chunk_pc,
+                                       [(label, addr - chunk_pc, file, ln) for label, addr, file, ln in offsets])
 
-    # ---------- Pass 1: label addresses ----------
+        if self.errors:
+            raise SystemExit("\n".join(self.errors))
 
-    def pass1(self) -> None:
-        pc = self.origin
-        for file, ln, line in self.lines:
+    def define_label(self, label, addr, file, ln) -> None:
+        if label in self.labels:
+            self.errors.append(f"{file}:{ln}: duplicate label '{label}'")
+        else:
+            self.labels[label] = addr
+
+    def pass1_lines(self, lines, pc):
+        """Assign label addresses for a run of lines. Returns (pc, labels, relocatable)."""
+        offsets = []
+        relocatable = True
+        for file, ln, line in lines:
             cur = line.strip()
             # Handle labels (possibly multiple)
             while True:
@@ -295,10 +491,8 @@ class Assembler:
                 if not m:
                     break
                 label, rest = m.group(1), m.group(2)
-                if label in self.labels:
-                    self.errors.append(f"{file}:{ln}: duplicate label '{label}'")
-                else:
-                    self.labels[label] = pc
+                self.define_label(label, pc, file, ln)
+                offsets.append((label, pc, file, ln))
                 cur = rest.strip()
                 if not cur:
                     break
@@ -307,6 +501,8 @@ class Assembler:
 
             # .org directive
             if cur.lower().startswith('.org'):
+                # Absolute placement: this chunk can't be replayed at another pc.
+                relocatable = False
                 parts = tokenize_operands(cur)
                 if len(parts) != 2:
                     self.errors.append(f"{file}:{ln}: .org requires one address")
@@ -324,9 +520,7 @@ class Assembler:
                 self.errors.append(f"{file}:{ln}: unknown mnemonic '{mnem}'")
                 continue
             pc += SIZES[op]
-
-        if self.errors:
-            raise SystemExit("\n".join(self.errors))
+        return pc, offsets, relocatable
 
     # ---------- Pass 2: encode ----------
 
@@ -342,8 +536,21 @@ class Assembler:
                 break
         # Labels win over numbers if exact match
         if val in self.labels:
-            return self.labels[val]
-        return parse_number(val)
+            res = self.labels[val]
+        else:
+            res = parse_number(val)
+        if self.used_tokens is not None:
+            self.used_tokens[tok] = res
+        return res
+
+    def tokens_unchanged(self, tokens) -> bool:
+        for tok, val in tokens.items():
+            try:
+                if self.eval_token(tok) != val:
+                    return False
+            except ValueError:
+                return False
+        return True
 
     def pass2(self) -> None:
         pc = self.origin
@@ -356,86 +563,119 @@ class Assembler:
                 seg_base = pc
 
         def emit(b:int) -> None:
-            if (b): out.append(b & 0xFF)
+            out.append(b & 0xFF)
 
-        for file, ln, line in self.lines:
-            cur = line.strip()
-            # Skip labels on this line
-            while True:
-                m = re.match(r'^([A-Za-z_]\w*):\s*(.*)$', cur)
-                if not m:
-                    break
-                cur = m.group(2).strip()
+        def set_org(file, ln, cur) -> None:
+            nonlocal out, pc, seg_base
+            if out and seg_base is not None:
+                self.segments.append((seg_base, bytes(out)))
+                out = []
+            parts = tokenize_operands(cur)
+            pc = self.eval_token(parts[1])
+            seg_base = None
+
+        for key, start, end in self.iter_chunks():
+            if start < end and is_org(self.lines[start][2]):
+                set_org(*self.lines[start])
+                start += 1
+            cacheable = bool(self.cache and key)
+            cached = self.cache.pass2(key) if cacheable else None
+            if cached is not None:
+                c_start, c_end, tokens, data = cached
+                if c_start == pc and self.tokens_unchanged(tokens):
+                    self.cache.hits += 1
+                    if c_end != c_start:
+                        start_segment_if_needed()
+                    out.extend(data)
+                    pc = c_end
+                    continue
+            if cacheable:
+                self.cache.misses += 1
+
+            errors = len(self.errors)
+            chunk_pc = pc
+            chunk_out = len(out)
+            relocatable = True
+            self.used_tokens = {}
+
+            for file, ln, line in self.lines[start:end]:
+                cur = line.strip()
+                # Skip labels on this line
+                while True:
+                    m = re.match(r'^([A-Za-z_]\w*):\s*(.*)$', cur)
+                    if not m:
+                        break
+                    cur = m.group(2).strip()
+                    if not cur:
+                        break
                 if not cur:
-                    break
-            if not cur:
-                continue
+                    continue
+
+                # .org
+                if cur.lower().startswith('.org'):
+                    relocatable = False
+                    set_org(file, ln, cur)
+                    continue
 
-            # .org
-            if cur.lower().startswith('.org'):
-                if out and seg_base is not None:
-                    self.segments.append((seg_base, bytes(out)))
-                    out = []
                 parts = tokenize_operands(cur)
-                pc = self.eval_token(parts[1])
-                seg_base = None
-                continue
+                mnem = parts[0].upper()
+                op = OPCODES.get(mnem)
+                if op is None:
+                    self.errors.append(f"{file}:{ln}: unknown mnemonic '{mnem}'")
+                    continue
+                size = SIZES[op]
+                start_segment_if_needed()
+                emit(op)
 
-            parts = tokenize_operands(cur)
-            mnem = parts[0].upper()
-            op = OPCODES.get(mnem)
-            if op is None:
-                self.errors.append(f"{file}:{ln}: unknown mnemonic '{mnem}'")
-                continue
-            size = SIZES[op]
-            start_segment_if_needed()
-            emit(op)
+                if size == 1:
+                    pc += 1
+                    continue
 
-            if size == 1:
-                pc += 1
-                continue
+                if op in REL_OPS:  # BR, BSR and the other rel8 branches
+                    if len(parts) != 2:
+                        self.errors.append(f"{file}:{ln}: {mnem} requires 1 operand")
+                        emit(0x00)  # placeholder
+                        pc += 2
+                        continue
+                    target = self.eval_token(parts[1])
+                    rel = target - (pc + 2)
+                    if rel < -128 or rel > 127:
+                        self.errors.append(f"{file}:{ln}: ${mnem} target out of range ({rel})")
+                    emit(rel & 0xFF)
+                    pc += 2
+                    continue
 
-            if size == 2:
-                # Immediate or zero-page style: single operand byte
-                if len(parts) != 2:
-                    self.errors.append(f"{file}:{ln}: {mnem} requires 1 operand")
-                    emit(0x00)
+                if size == 2:
+                    # Immediate or zero-page style: single operand byte
+                    if len(parts) != 2:
+                        self.errors.append(f"{file}:{ln}: {mnem} requires 1 operand")
+                        emit(0x00)
+                        pc += 2
+                        continue
+                    val = self.eval_token(parts[1])
+                    if val < 0 or val > 0xFF:
+                        self.errors.append(f"{file}:{ln}: operand out of range for {mnem}: {val}")
+                    emit(val)
                     pc += 2
                     continue
-                val = self.eval_token(parts[1])
-                if val < 0 or val > 0xFF:
-                    self.errors.append(f"{file}:{ln}: operand out of range for {mnem}: {val}")
-                emit(val)
-                pc += 2
-                continue
 
 
-            if op in (0x0B, 0x12, 0x14, 0x15, 0x16, 0x18, 0x2B):  # BR or BSR
+                # abs16 ops
                 if len(parts) != 2:
                     self.errors.append(f"{file}:{ln}: {mnem} requires 1 operand")
-                    emit(0x00)  # placeholder
-                    pc += 2
+                    emit(0x00); emit(0x00)
+                    pc += 3
                     continue
-                target = self.eval_token(parts[1])
-                rel = target - (pc + 2)
-                if rel < -128 or rel > 127:
-                    self.errors.append(f"{file}:{ln}: ${mnem} target out of range ({rel})")
-                emit(rel & 0xFF)
-                pc += 2
-                continue
-
-            # abs16 ops
-            if len(parts) != 2:
-                self.errors.append(f"{file}:{ln}: {mnem} requires 1 operand")
-                emit(0x00); emit(0x00)
+                addr = self.eval_token(parts[1])
+                if addr < 0 or addr > 0xFFFF:
+                    self.errors.append(f"{file}:{ln}: address out of range for {mnem}: {addr}")
+                emit(addr & 0xFF)
+                emit((addr >> 8) & 0xFF)
                 pc += 3
-                continue
-            addr = self.eval_token(parts[1])
-            if addr < 0 or addr > 0xFFFF:
-                self.errors.append(f"{file}:{ln}: address out of range for {mnem}: {addr}")
-            emit(addr & 0xFF)
-            emit((addr >> 8) & 0xFF)
-            pc += 3
+
+            if cacheable and relocatable and len(self.errors) == errors:
+                self.cache.store_pass2(key, chunk_pc, pc, self.used_tokens, bytes(out[chunk_out:]))
+            self.used_tokens = None
 
         if out and seg_base is not None:
             self.segments.append((seg_base, bytes(out)))
@@ -485,6 +725,296 @@ class Assembler:
         hdr += bytes([csum & 0xFF, (csum >> 8) & 0xFF])
         return bytes(hdr) + img
 
+# ---------------- Peephole optimizer ----------------
+
+F_C, F_Z, F_V, F_N = 0x01, 0x02, 0x40, 0x80
+F_ALL = F_C | F_Z | F_V | F_N
+
+# (flags read, flags written) for each opcode, as implemented in CPU::step()
+FLAG_EFFECTS = {
+    0x00: (0, F_ALL), 0x01: (0, F_ALL), 0x02: (0, F_N | F_Z), 0x03: (0, F_N | F_Z),
+    0x07: (0, F_N | F_Z), 0x08: (0, 0), 0x09: (0, F_N | F_Z), 0x0A: (0, 0),
+    0x0C: (0, F_N | F_Z), 0x0D: (0, F_N | F_Z), 0x0E: (0, F_N | F_Z), 0x0F: (0, 0),
+    0x19: (0, F_N | F_Z | F_C), 0x1A: (0, F_N | F_Z | F_C),
+    0x1B: (0, F_N | F_Z | F_C), 0x1C: (0, F_N | F_Z | F_C),
+    0x1D: (0, F_N | F_Z), 0x1E: (0, F_N | F_Z), 0x1F: (0, F_N | F_Z),
+    0x20: (0, F_ALL), 0x21: (0, F_C), 0x22: (0, F_N), 0x23: (0, F_Z),
+    0x24: (0, F_N | F_Z), 0x28: (0, F_ALL), 0x29: (0, F_ALL),
+    0x2C: (0, 0), 0x2D: (0, F_N | F_Z), 0x2E: (0, 0), 0x2F: (0, F_N | F_Z),
+    0x30: (0, F_N | F_Z), 0x31: (0, F_N | F_Z), 0x32: (0, F_ALL), 0x33: (0, 0),
+    0x34: (F_C, F_ALL), 0x35: (F_C, F_ALL), 0x36: (0, 0),
+    0x38: (F_C, F_N | F_Z | F_C), 0x39: (F_C, F_N | F_Z | F_C),
+    0x3A: (0, F_N | F_Z | F_C), 0x3B: (0, F_N | F_Z | F_C),
+    0x44: (0, F_Z | F_C), 0x45: (0, F_Z), 0x46: (0, F_ALL), 0x47: (0, F_ALL),
+    0x48: (0, F_ALL), 0x49: (0, F_ALL), 0x4A: (0, F_N | F_Z | F_V), 0x4B: (0, F_N | F_Z),
+    0x4C: (0, F_ALL), 0x4D: (0, F_N | F_Z), 0x4E: (0, F_N | F_Z), 0x4F: (0, F_N | F_Z),
+    0x50: (0, 0), 0x51: (0, 0), 0x52: (0, 0), 0x53: (0, F_N | F_Z | F_C),
+    0x54: (0, F_V), 0x55: (0, F_V), 0x56: (0, F_ALL), 0x57: (0, F_ALL),
+    0x58: (0, F_Z | F_C), 0x59: (0, F_Z | F_C),
+    0x5A: (0, F_N | F_Z), 0x5B: (0, F_Z), 0x5C: (0, 0),
+}
+
+# Opcodes that leave straight-line flow; flag liveness is not tracked past them.
+CONTROL_OPS = {
+    0x04, 0x05, 0x06, 0x0B, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18,
+    0x25, 0x26, 0x27, 0x2A, 0x2B, 0x37, 0x3C, 0x3D, 0x3E, 0x3F, 0x40, 0x41, 0x42, 0xFF,
+}
+
+# Absolute branch -> rel8 branch with the same condition
+REL_FORMS = {0x04: 0x0B, 0x13: 0x14, 0x16: 0x15, 0x17: 0x18, 0x2A: 0x2B, 0x3C: 0x3E, 0x3D: 0x3F}
+
+CALL_OPS = {0x10, 0x12, 0x25, 0x40}
+
+OP_LDA, OP_STA, OP_LDX, OP_LD2, OP_CLF = 0x09, 0x0A, 0x0E, 0x4A, 0x20
+FLAG_CLEARS = {0x20, 0x21, 0x22, 0x23}
+IO_PAGE = 0xFF  # $FF00-$FFFF: device registers, where a load has side effects
+
+def is_io(addr) -> bool:
+    return addr is not None and (addr >> 8) & 0xFF == IO_PAGE
+
+MNEMONICS = {}
+for _name, _op in OPCODES.items():
+    MNEMONICS.setdefault(_op, _name)
+
+class Insn:
+    __slots__ = ('labels', 'op', 'operands', 'org')
+
+    def __init__(self, labels, op=None, operands=None, org=None) -> None:
+        self.labels = labels
+        self.op = op
+        self.operands = operands or []
+        self.org = org
+
+    def copy(self):
+        return Insn(list(self.labels), self.op, list(self.operands), self.org)
+
+    def text(self) -> str:
+        parts = [f"{l}:" for l in self.labels]
+        if self.org is not None:
+            parts.append(f".org {self.org}")
+        elif self.op is not None:
+            parts.append(" ".join([MNEMONICS[self.op]] + self.operands))
+        return " ".join(parts)
+
+class Peephole:
+    """
+    Optional pass that rewrites common sequences into cheaper ones according
+    to CYCLES, before pass 1:
+      - LDA a / LDX a+1           -> LD2 a
+      - absolute branch in range  -> rel8 branch (when not more expensive)
+      - flag clears whose result is never read, or that repeat a clear
+      - STA a / LDA a             -> STA a
+    Loads from the I/O page ($FF00-$FFFF) are never merged or dropped.
+    Rewrites that change flags are only made when the affected flags are
+    overwritten before being read on the straight-line path. Lines are never
+    removed, only blanked, so labels and chunk boundaries stay in place.
+    """
+
+    def __init__(self, asm) -> None:
+        self.asm = asm
+        self.saved = {}  # function label -> cycles saved
+
+    def parse(self) -> list:
+        insns = []
+        for file, ln, line in self.asm.lines:
+            cur = line.strip()
+            labels = []
+            while True:
+                m = re.match(r'^([A-Za-z_]\w*):\s*(.*)$', cur)
+                if not m:
+                    break
+                labels.append(m.group(1))
+                cur = m.group(2).strip()
+            if not cur:
+                insns.append(Insn(labels))
+                continue
+            parts = tokenize_operands(cur)
+            if is_org(cur):
+                insns.append(Insn(labels, org=parts[1] if len(parts) > 1 else ''))
+                continue
+            op = OPCODES.get(parts[0].upper())
+            if op is None or op not in SIZES:
+                # Leave anything we don't understand for pass 1 to report.
+                insns.append(None)
+                continue
+            insns.append(Insn(labels, op, parts[1:]))
+        return insns
+
+    def value(self, tok):
+        try:
+            return self.asm.eval_token(tok)
+        except ValueError:
+            return None
+
+    def layout(self, insns) -> list:
+        asm = self.asm
+        asm.labels = {}
+        pcs = []
+        pc = asm.origin
+        for ins in insns:
+            pcs.append(pc)
+            if ins is None:
+                continue
+            for label in ins.labels:
+                asm.labels.setdefault(label, pc)
+            if ins.org is not None:
+                pc = self.value(ins.org) or 0
+            elif ins.op is not None:
+                pc += SIZES[ins.op]
+        return pcs
+
+    def next_insn(self, insns, i):
+        """Index of the instruction after i, or None if a label or .org intervenes."""
+        for j in range(i + 1, len(insns)):
+            ins = insns[j]
+            if ins is None or ins.labels or ins.org is not None:
+                return None
+            if ins.op is not None:
+                return j
+        return None
+
+    def dead_after(self, insns, i, flags) -> bool:
+        """True if every flag in `flags` is overwritten before being read after insn i."""
+        for ins in insns[i + 1:]:
+            if ins is None or ins.org is not None:
+                return False
+            if ins.op is None:
+                continue
+            if ins.op in CONTROL_OPS:
+                return False
+            use, define = FLAG_EFFECTS.get(ins.op, (F_ALL, 0))
+            if use & flags:
+                return False
+            flags &= ~define
+            if not flags:
+                return True
+        return False
+
+    def single(self, ins, op):
+        return ins is not None and ins.op == op and len(ins.operands) == 1
+
+    def try_rewrite(self, insns, pcs, i):
+        """Apply one rewrite at insn i. Returns (kind, cycles saved, first, second) or None."""
+        ins = insns[i]
+        if ins is None or ins.op is None:
+            return None
+        op = ins.op
+
+        if op in (OP_LDA, OP_LDX) and len(ins.operands) == 1:
+            j = self.next_insn(insns, i)
+            other = OP_LDX if op == OP_LDA else OP_LDA
+            if j is not None and self.single(insns[j], other):
+                lda, ldx = (ins, insns[j]) if op == OP_LDA else (insns[j], ins)
+                a, x = self.value(lda.operands[0]), self.value(ldx.operands[0])
+                if a is not None and x is not None and a + 1 == x and a < 0xFFFF \
+                        and not is_io(a) and not is_io(x) and self.dead_after(insns, j, F_N | F_Z | F_V):
+                    operand = lda.operands[0]
+                    ins.op, ins.operands = OP_LD2, [operand]
+                    insns[j].op, insns[j].operands = None, []
+                    return ('ld2', CYCLES[OP_LDA] + CYCLES[OP_LDX] - CYCLES[OP_LD2], i, j)
+
+        if op in REL_FORMS and len(ins.operands) == 1:
+            rel_op = REL_FORMS[op]
+            target = self.value(ins.operands[0])
+            if target is not None and CYCLES[rel_op] <= CYCLES[op] \
+                    and -128 <= target - (pcs[i] + 2) <= 127:
+                ins.op = rel_op
+                return ('rel', CYCLES[op] - CYCLES[rel_op], i, None)
+
+        if op in FLAG_CLEARS:
+            _, cleared = FLAG_EFFECTS[op]
+            prev = self.prev_insn(insns, i)
+            already = prev is not None and insns[prev].op in FLAG_CLEARS \
+                and (FLAG_EFFECTS[insns[prev].op][1] & cleared) == cleared
+            if already or self.dead_after(insns, i, cleared):
+                ins.op = None
+                return ('clear', CYCLES[op], i, None)
+
+        if op == OP_STA and len(ins.operands) == 1:
+            j = self.next_insn(insns, i)
+            if j is not None and self.single(insns[j], OP_LDA):
+                a, b = self.value(ins.operands[0]), self.value(insns[j].operands[0])
+                if a is not None and a == b and not is_io(a) and self.dead_after(insns, j, F_N | F_Z):
+                    insns[j].op, insns[j].operands = None, []
+                    return ('reload', CYCLES[OP_LDA], i, j)
+        return None
+
+    def prev_insn(self, insns, i):
+        if insns[i].labels:
+            return None
+        for j in range(i - 1, -1, -1):
+            ins = insns[j]
+            if ins is None or ins.org is not None:
+                return None
+            if ins.op is not None:
+                return j
+            if ins.labels:
+                return None
+        return None
+
+    def still_valid(self, insns, pcs, rewrite) -> bool:
+        kind, _, i, j = rewrite
+        ins = insns[i]
+        if kind == 'rel':
+            target = self.value(ins.operands[0])
+            return target is not None and -128 <= target - (pcs[i] + 2) <= 127
+        if kind == 'ld2':
+            # The dropped LDX operand was checked against the old layout.
+            orig = self.original
+            ldx = orig[i] if orig[i].op == OP_LDX else orig[j]
+            a, x = self.value(ins.operands[0]), self.value(ldx.operands[0])
+            return a is not None and x is not None and a + 1 == x and not is_io(a) and not is_io(x)
+        if kind == 'reload':
+            a = self.value(ins.operands[0])
+            return a == self.value(self.original[j].operands[0]) and not is_io(a)
+        return True
+
+    def functions(self, insns) -> set:
+        calls = set()
+        for ins in insns:
+            if ins is not None and ins.op in CALL_OPS and ins.operands:
+                calls.add(ins.operands[0])
+        return calls
+
+    def run(self) -> int:
+        self.original = self.parse()
+        rejected = set()
+        while True:
+            insns = [ins.copy() if ins else None for ins in self.original]
+            applied = []
+            pcs = self.layout(insns)
+            for i in range(len(insns)):
+                if i in rejected:
+                    continue
+                rewrite = self.try_rewrite(insns, pcs, i)
+                if rewrite:
+                    applied.append(rewrite)
+            # Shrinking code moves labels; drop anything the new layout breaks and start over.
+            pcs = self.layout(insns)
+            bad = {r[2] for r in applied if not self.still_valid(insns, pcs, r)}
+            if not bad:
+                break
+            rejected |= bad
+
+        calls = self.functions(self.original)
+        owner = None
+        owners = []
+        for ins in self.original:
+            if ins is not None:
+                for label in ins.labels:
+                    if not calls or label in calls:
+                        owner = label
+            owners.append(owner or '<top>')
+        for kind, cycles, i, _ in applied:
+            self.saved[owners[i]] = self.saved.get(owners[i], 0) + cycles
+
+        for i, ins in enumerate(insns):
+            if ins is not None and (ins.op != self.original[i].op or ins.operands != self.original[i].operands):
+                file, ln, _ = self.asm.lines[i]
+                self.asm.lines[i] = (file, ln, ins.text())
+        self.asm.labels = {}
+        return len(applied)
+
 # ---------------- CLI ----------------
 
 def main() -> None:
@@ -498,6 +1028,9 @@ def main() -> None:
     ap.add_argument("--output", "-O", help="Output file path (defaults: stdout for cpp, input with .rom for rom)")
     ap.add_argument("-I", dest="includes", action="append", default=[], help="Add include search path")
     ap.add_argument("-D", dest="defines", action="append", default=[], help="Define NAME=VALUE or NAME")
+    ap.add_argument("--cache-dir", help="Incremental build cache directory (default: .asmcache next to the input)")
+    ap.add_argument("--no-cache", action="store_true", help="Rebuild everything and don't touch the build cache")
+    ap.add_argument("--peephole", action="store_true", help="Rewrite common sequences into cheaper instructions")
     args = ap.parse_args()
 
     def parse_def(d):
@@ -511,7 +1044,12 @@ def main() -> None:
     fill = parse_number(args.fill)
 
     starttime = time.monotonic()
-    asm = Assembler(origin=origin, fill=fill, include_paths=args.includes, cli_defines=cli_defines)
+    cache = None
+    # The peephole pass depends on label values across files, which the chunk cache can't track.
+    if args.input != "-" and not args.no_cache and not args.peephole:
+        cache_dir = args.cache_dir or os.path.join(os.path.dirname(os.path.abspath(args.input)), ".asmcache")
+        cache = BuildCache(os.path.join(cache_dir, os.path.basename(args.input) + ".cache"))
+    asm = Assembler(origin=origin, fill=fill, include_paths=args.includes, cli_defines=cli_defines, cache=cache)
 
     if args.input == "-":
         # For stdin, write to a temp synthetic "stdin.asm" node
@@ -519,8 +1057,18 @@ def main() -> None:
     else:
         asm.load_file(args.input)
 
+    if args.peephole:
+        opt = Peephole(asm)
+        count = opt.run()
+        total = sum(opt.saved.values())
+        sys.stderr.write(f"Peephole: {count} rewrites, {total} cycles saved\n")
+        for func, cycles in opt.saved.items():
+            sys.stderr.write(f"  {func}: {cycles} cycles\n")
+
     asm.pass1()
     asm.pass2()
+    if cache:
+        cache.save()
 
     if args.out_format == "cpp":
         text = asm.to_cpp(var=args.var, origin=origin)
@@ -540,6 +1088,8 @@ def main() -> None:
         endtime = time.monotonic()
         # Print a short note to stderr
         sys.stderr.write(f"Wrote ROM: {out_path} Built ROM in {(endtime-starttime) * 1000} milliseconds.\n ROM Size bytes:{len(blob) - 12} Excluding 12-byte Header.")
+        if cache:
+            sys.stderr.write(f"\n Cache: reused {cache.hits} of {cache.hits + cache.misses} chunks.\n")
 
 if __name__ == "__main__":
     main()
\ No newline at end of file
@@ -0,0 +1,48 @@
+; -------------------
+; ALU benchmark
+; Mixes add/subtract with and without carry, negate, shifts, rotates and
+; flag-only compares into an 8-bit accumulator, about 4000 times.
+; -------------------
+        .org 0
+
+.equ I      $1000   ; 16-bit loop counter (lo, hi)
+.equ IH     $1001
+.equ ACC    $1002   ; accumulator
+
+Main:
+        LDI $80
+        STA I
+        LDI $10
+        STA IH
+        LDI 0
+        STA ACC
+
+Loop:
+        LDA ACC
+        LDX I
+        ADD             ; A += X
+        ADC 17
+        ROL
+        SBC 3
+        SUB             ; A -= X
+        NEG
+        ASL
+        ADC $55
+        ROR
+        ASR
+        TST
+        ADDF
+        INC
+        STA ACC
+
+        LDA I
+        DEC
+        STA I
+        BNZ Loop
+        LDA IH
+        DEC
+        STA IH
+        BNZ Loop
+
+        LDA ACC
+        HALT
@@ -0,0 +1,20 @@
+; -------------------
+; Bank switching example: run with --banks 8 --run --core PATH.
+; Maps bank 5 into window 0 ($8000-$9FFF), writes a HALT and a marker
+; byte ($42) into it and jumps there, so the program halts inside the
+; switched window. The core file (and --dump-range 0x8000-0x800F) must
+; show $FF $42 at $8000, the contents of bank 5, not of bank 0.
+; -------------------
+        .org 0
+
+.equ Sel0   $FF10   ; window 0 bank select
+.equ Win    $8000
+
+Main:
+        LDI 5
+        STA Sel0
+        LDI $FF         ; HALT
+        STA Win
+        LDI $42
+        STA $8001
+        B Win
@@ -0,0 +1,80 @@
+; -------------------
+; BCD benchmark
+; Adds the 6-digit amount 123456 into a 10-digit packed BCD total 1000
+; times with DADD, then subtracts 654321 once with DSUB.
+; Expected total: 123456000 - 654321 = 0122801679, i.e. bytes
+; 79 16 80 12 01 at $1010, least significant first; the emulator shows
+; A=79 X=16 on HALT.
+; -------------------
+        .org 0
+
+.equ I      $1000   ; 16-bit loop counter (lo, hi)
+.equ IH     $1001
+.equ TOT    $1010   ; 5-byte total
+.equ AMT0   $1020   ; 5-byte amount, starts zeroed
+.equ AMT1   $1021
+.equ AMT2   $1022
+.equ SUB0   $1028   ; 5-byte value to subtract
+.equ SUB1   $1029
+.equ SUB2   $102A
+.equ DA0    $1030   ; DADD descriptor: dst(2) src(2) len(2)
+.equ DA1    $1031
+.equ DA2    $1032
+.equ DA3    $1033
+.equ DA4    $1034
+.equ DS0    $1036   ; DSUB descriptor
+.equ DS1    $1037
+.equ DS2    $1038
+.equ DS3    $1039
+.equ DS4    $103A
+
+Main:
+        LDI $E8         ; 1000 = $03E8, high byte counts down from 4
+        STA I
+        LDI 4
+        STA IH
+
+        LDI $56         ; amount 00 00 12 34 56
+        STA AMT0
+        LDI $34
+        STA AMT1
+        LDI $12
+        STA AMT2
+        LDI $21         ; subtrahend 00 00 65 43 21
+        STA SUB0
+        LDI $43
+        STA SUB1
+        LDI $65
+        STA SUB2
+
+        LDI $10         ; DADD: dst $1010, src $1020, len 5
+        STA DA0
+        LDI $20
+        STA DA2
+        LDI 5
+        STA DA4
+        LDI $10
+        STA DA1
+        STA DA3
+        STA DS1         ; DSUB: dst $1010, src $1028, len 5
+        STA DS3
+        STA DS0
+        LDI $28
+        STA DS2
+        LDI 5
+        STA DS4
+
+Loop:
+        DADD DA0
+        LDA I
+        DEC
+        STA I
+        BNZ Loop
+        LDA IH
+        DEC
+        STA IH
+        BNZ Loop
+
+        DSUB DS0
+        LD2 TOT         ; A:X = lowest two bytes of the total
+        HALT
@@ -0,0 +1,28 @@
+; -------------------
+; Console example: prints a greeting, then copies input to output until
+; input ends. Try: echo hello | emulator console.bin --run
+; -------------------
+        .org 0
+
+.equ Data   $FF30   ; CON_DATA
+.equ Status $FF31   ; CON_STATUS: bit 0 = input ready, bit 1 = end of input
+
+Main:
+        LDI 79          ; 'O'
+        STA Data
+        LDI 75          ; 'K'
+        STA Data
+        LDI 10          ; newline
+        STA Data
+
+Poll:
+        LDA Status
+        BZ Poll         ; nothing yet
+        ASR             ; C = input ready
+        BNC Done        ; end of input
+        LDA Data
+        STA Data
+        B Poll
+
+Done:
+        HALT
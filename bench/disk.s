@@ -0,0 +1,62 @@
+; -------------------
+; Block device example: run with --disk PATH --disk-size 64.
+; Fills a 512-byte buffer, writes it to sector 3, clears the buffer, reads
+; sector 3 back and halts with A = the first byte read ($5A) and X = the
+; status ($01 = done, no error).
+; -------------------
+        .org 0
+
+.equ Cmd    $FF40   ; write: command, read: status
+.equ Sec0   $FF41
+.equ Sec1   $FF42
+.equ Sec2   $FF43
+.equ BufLo  $FF44
+.equ BufHi  $FF45
+.equ Count  $FF46
+.equ Buf    $2000
+.equ Fill   $1000   ; BFILL descriptor: dst(2) len(2)
+.equ FillDh $1001
+.equ FillLl $1002
+.equ FillLh $1003
+
+Main:
+        LDI $00         ; descriptor: dst = Buf, len = 512
+        STA Fill
+        LDI $20
+        STA FillDh
+        LDI $00
+        STA FillLl
+        LDI $02
+        STA FillLh
+        LDI $5A
+        BFILL Fill
+
+        LDI 3           ; sector 3, buffer $2000, one sector
+        STA Sec0
+        LDI 0
+        STA Sec1
+        STA Sec2
+        STA BufLo
+        LDI $20
+        STA BufHi
+        LDI 1
+        STA Count
+        LDI 2           ; write
+        STA Cmd
+        JSR Wait
+
+        LDI 0
+        BFILL Fill      ; clear the buffer
+        LDI 1           ; read it back
+        STA Cmd
+        JSR Wait
+
+        LDA Buf
+        HALT
+
+Wait:
+        LDX Cmd
+        XTA
+        ASR             ; C = done
+        BNC Wait
+        RTS
@@ -0,0 +1,68 @@
+; -------------------
+; Framebuffer example: run with --fb-ppm DIR (or --fb-raw PATH).
+; Draws one 128-pixel row per frame, 16 rows in palette colors 1..16,
+; then leaves the screen alone for 2 frames and halts. Only the 16
+; frames that changed are written as images. At the default
+; --fb-interval of 50000 cycles that is 18 frames, about 900000 cycles,
+; so it halts within --run's 1000000-cycle cap.
+; -------------------
+        .org 0
+
+.equ Frame  $FF52   ; FB_FRAME: frames emitted so far
+.equ Desc   $1000   ; BFILL descriptor: dst(2) len(2)
+.equ LenLo  $1002
+.equ LenHi  $1003
+.equ Step   $1004   ; 16-bit row length (128)
+.equ StepHi $1005
+.equ Color  $1006
+.equ Last   $1007   ; frame counter at the last check
+.equ Idle   $1008
+
+Main:
+        LDI $C0         ; dst = $C000 (row 0)
+        ATX
+        LDI $00
+        ST2 Desc
+        LDI 128
+        STA LenLo
+        STA Step
+        LDI 0
+        STA LenHi
+        STA StepHi
+        LDI 1
+        STA Color
+        LDA Frame
+        STA Last
+
+Row:
+        LDA Color
+        BFILL Desc      ; fill the row with Color
+        LD2 Desc
+        ADD16 Step      ; next row
+        ST2 Desc
+        JSR NextFrame
+        LDA Color
+        INC
+        STA Color
+        ATX
+        LDI 17
+        SUBF            ; Z once colors 1..16 are drawn
+        BNZ Row
+
+        LDI 2
+        STA Idle
+Rest:
+        JSR NextFrame
+        LDA Idle
+        DEC
+        STA Idle
+        BNZ Rest
+        HALT
+
+NextFrame:              ; waits until FB_FRAME moves on
+        LDA Frame
+        LDX Last
+        SUBF
+        BZ NextFrame
+        STA Last
+        RTS
@@ -0,0 +1,42 @@
+; -------------------
+; Multiply benchmark, hardware version
+; Sums I * (I + 3) for I = 100..1 into a 16-bit checksum using MUL.
+; Compare with mul_soft.s, which does the same with a shift-and-add routine.
+; -------------------
+        .org 0
+
+.equ I      $1000   ; loop counter / multiplicand
+.equ Mpr    $1001   ; multiplier
+.equ RL     $1002   ; 16-bit product (lo, hi)
+.equ CK     $1004   ; 16-bit checksum (lo, hi)
+.equ CKH    $1005
+
+Main:
+        LDI 100
+        STA I
+        LDI 0
+        STA CK
+        STA CKH
+
+Loop:
+        LDA I
+        INC
+        INC
+        INC
+        STA Mpr
+        ATX             ; X = I + 3
+        LDA I           ; A = I
+        MUL             ; A:X = I * (I + 3)
+        ST2 RL
+
+        LD2 CK
+        ADD16 RL
+        ST2 CK
+
+        LDA I
+        DEC
+        STA I
+        BNZ Loop
+
+        LD2 CK          ; A:X = checksum
+        HALT
@@ -0,0 +1,88 @@
+; -------------------
+; Multiply benchmark, software version
+; Sums I * (I + 3) for I = 100..1 into a 16-bit checksum using an 8x8
+; shift-and-add routine. Compare with mul_hw.s.
+; -------------------
+        .org 0
+
+.equ I      $1000   ; loop counter / multiplicand
+.equ Mpr    $1001   ; multiplier
+.equ RL     $1002   ; 16-bit product (lo, hi)
+.equ RH     $1003
+.equ CK     $1004   ; 16-bit checksum (lo, hi)
+.equ CKH    $1005
+.equ MCL    $1006   ; shifted multiplicand (lo, hi)
+.equ MCH    $1007
+.equ Cnt    $1008   ; bit counter
+
+Main:
+        LDI 100
+        STA I
+        LDI 0
+        STA CK
+        STA CKH
+
+Loop:
+        LDA I
+        STA MCL
+        INC
+        INC
+        INC
+        STA Mpr
+        JSR SwMul       ; RL:RH = I * (I + 3)
+
+        LD2 CK
+        ADD16 RL
+        ST2 CK
+
+        LDA I
+        DEC
+        STA I
+        BNZ Loop
+
+        LD2 CK          ; A:X = checksum
+        HALT
+
+; -------------------
+; SwMul: RL:RH = MCL * Mpr (clobbers MCL, MCH, Mpr, Cnt)
+; -------------------
+SwMul:
+        LDI 0
+        STA RL
+        STA RH
+        STA MCH
+        LDI 8
+        STA Cnt
+
+SwLoop:
+        CLC
+        LDA Mpr
+        ROR             ; C = low bit of multiplier
+        STA Mpr
+        BNC SwSkip
+
+        LDA RL          ; RL:RH += MCL:MCH
+        LDX MCL
+        ADD
+        STA RL
+        LDA RH
+        BNC SwNoC
+        INC
+SwNoC:
+        LDX MCH
+        ADD
+        STA RH
+
+SwSkip:
+        LDA MCL         ; MCL:MCH <<= 1
+        ASL
+        STA MCL
+        LDA MCH
+        ROL
+        STA MCH
+
+        LDA Cnt
+        DEC
+        STA Cnt
+        BNZ SwLoop
+        RTS
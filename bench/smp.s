@@ -0,0 +1,71 @@
+; -------------------
+; SMP example: run with --smp N (N = 1..5).
+; Every core adds 1 to a shared counter 50 times with a CAS loop, then
+; reports to core 0 through its mailbox. Core 0 waits for all reports and
+; halts with A = 50 * N.
+; -------------------
+        .org 0
+
+.equ CoreId  $FF20
+.equ Cores   $FF21
+.equ Target  $FF22
+.equ Send    $FF23
+.equ Status  $FF24
+.equ Recv    $FF25
+.equ Counter $2000   ; shared by all cores
+.equ N       $1200   ; stack page: private to each core
+.equ Left    $1201
+
+Main:
+        LDI 50
+        STA N
+
+Next:
+        LDA Counter     ; A = value we expect to replace
+Retry:
+        INC
+        ATX             ; X = expected + 1
+        DEC
+        CAS Counter     ; Z = stored; otherwise A = current value
+        BNZ Retry
+
+        LDA N
+        DEC
+        STA N
+        BNZ Next
+
+        LDA CoreId
+        BZ Collect
+
+        LDI 0
+        STA Target
+Report:
+        LDA CoreId
+        STA Send
+        LDA Status      ; C = MBOX_TX_FAILED after two shifts
+        ASR
+        ASR
+        BC Report       ; core 0's mailbox still full: retry
+        HALT
+
+Collect:
+        LDA Cores
+        DEC
+        STA Left
+Wait:
+        LDA Left
+        BZ Done
+Poll:
+        LDA Status      ; C = MBOX_RX_FULL
+        ASR
+        BNC Poll
+        LDA Recv
+        LDA Left
+        DEC
+        STA Left
+        BR Wait
+
+Done:
+        FENCE
+        LDA Counter     ; 50 * cores
+        HALT
@@ -0,0 +1,138 @@
+#!/usr/bin/env python3
+"""Viewer for post-mortem core files (include/core.h, written by --core).
+
+    python3 coreview.py run.core                    # registers and PC history
+    python3 coreview.py run.core --hex 0x1000-0x10FF
+    python3 coreview.py run.core --dis 0x0000-0x0040
+
+Without --hex or --dis it also disassembles the instructions around the
+stop PC. The instruction set tables are taken from assemble.py.
+"""
+import argparse
+import os
+import struct
+import sys
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from assemble import MNEMONICS, REL_OPS, SIZES, parse_number
+
+# ---------- Core file ----------
+
+CORE_VERSION = 1
+CORE_MEM_OFFSET = 256
+
+STOPS = {0: 'none', 1: 'HALT', 2: 'fault', 3: 'breakpoint', 4: 'watchpoint'}
+FAULTS = {0: 'none', 1: 'stack overflow', 2: 'stack underflow', 3: 'unknown opcode'}
+FLAGS = 'CZIHBUVN'  # bit 0 first
+
+class Core:
+    def __init__(self, path):
+        with open(path, 'rb') as fh:
+            data = fh.read()
+        if len(data) < CORE_MEM_OFFSET + 65536 or data[:4] != b'MR8D':
+            raise ValueError(f"not a core file: {path}")
+        version, count = struct.unpack_from('<HH', data, 4)
+        if version != CORE_VERSION:
+            raise ValueError(f"unsupported core version {version}: {path}")
+        (self.a, self.x, self.sp, self.p, self.pc, self.op_pc, self.halted, self.stop,
+         self.fault) = struct.unpack_from('<BBBBHHBBB', data, 8)
+        self.fault_pc, = struct.unpack_from('<H', data, 20)
+        self.cycles, self.clock, self.instret = struct.unpack_from('<IxxxxQQ', data, 24)
+        self.history = list(struct.unpack_from(f'<{count}H', data, 64))
+        self.mem = data[CORE_MEM_OFFSET:CORE_MEM_OFFSET + 65536]
+
+    def reason(self):
+        if not self.halted:
+            return 'step limit (still running)'
+        if self.stop == 2:
+            return f"fault: {FAULTS.get(self.fault, self.fault)} at ${self.fault_pc:04X}"
+        return STOPS.get(self.stop, str(self.stop))
+
+# ---------- Formatting ----------
+
+def flags(p):
+    return ''.join(FLAGS[i] if p >> i & 1 else '-' for i in reversed(range(8)))
+
+def hexdump(mem, start, end):
+    for line in range(start & ~15, end + 1, 16):
+        row = mem[line:line + 16]
+        cells = ' '.join(f"{b:02x}" if start <= line + i <= end else '  ' for i, b in enumerate(row))
+        text = ''.join((chr(b) if 32 <= b < 127 else '.') if start <= line + i <= end else ' ' for i, b in enumerate(row))
+        print(f"{line:04x}: {cells}  {text}")
+
+def disasm_one(mem, addr):
+    """Returns (size, text) for the instruction at addr."""
+    op = mem[addr]
+    if op not in MNEMONICS:
+        return 1, f".byte ${op:02X}"
+    size = SIZES.get(op, 1)
+    operand = [mem[(addr + i) & 0xFFFF] for i in range(1, size)]
+    if size == 1:
+        return 1, MNEMONICS[op]
+    if size == 2 and op in REL_OPS:
+        off = operand[0] - 256 if operand[0] >= 128 else operand[0]
+        return 2, f"{MNEMONICS[op]} ${(addr + 2 + off) & 0xFFFF:04X}"
+    if size == 2:
+        return 2, f"{MNEMONICS[op]} ${operand[0]:02X}"
+    return 3, f"{MNEMONICS[op]} ${operand[0] | operand[1] << 8:04X}"
+
+def disasm_line(mem, addr, mark=''):
+    size, text = disasm_one(mem, addr)
+    raw = ' '.join(f"{mem[(addr + i) & 0xFFFF]:02x}" for i in range(size))
+    print(f"{mark:2}{addr:04x}: {raw:<9} {text}")
+    return size
+
+def disassemble(mem, start, end, mark_pc=None):
+    addr = start
+    while addr <= end:
+        addr += disasm_line(mem, addr, '>' if addr == mark_pc else '')
+
+def parse_range(s):
+    lo, _, hi = s.partition('-')
+    start = parse_number(lo) & 0xFFFF
+    end = parse_number(hi) & 0xFFFF if hi else start
+    if end < start:
+        raise argparse.ArgumentTypeError(f"range end below start: {s}")
+    return start, end
+
+# ---------- Main ----------
+
+def main() -> None:
+    ap = argparse.ArgumentParser(description="Show a post-mortem core file")
+    ap.add_argument("core", help="Core file written by --core")
+    ap.add_argument("--hex", type=parse_range, action="append", default=[], metavar="START-END",
+                    help="Hexdump a memory range")
+    ap.add_argument("--dis", type=parse_range, action="append", default=[], metavar="START-END",
+                    help="Disassemble a memory range")
+    ap.add_argument("--no-history", action="store_true", help="Don't list the PC history")
+    args = ap.parse_args()
+
+    try:
+        core = Core(args.core)
+    except (OSError, ValueError) as e:
+        sys.exit(f"Error: {e}")
+
+    print(f"Stopped: {core.reason()}")
+    print(f"PC=${core.pc:04X}  op_pc=${core.op_pc:04X}  A=${core.a:02X}  X=${core.x:02X}  "
+          f"SP=${core.sp:02X}  P={flags(core.p)}")
+    print(f"{core.clock} cycles, {core.instret} instructions")
+
+    if not args.no_history and core.history:
+        print(f"\nLast {len(core.history)} instructions, oldest first:")
+        for addr in core.history:
+            disasm_line(core.mem, addr)
+
+    if not args.hex and not args.dis:
+        # Instructions are variable length, so disassembly can only start
+        # at a known instruction: the last one executed.
+        print("\nAt the stop:")
+        disassemble(core.mem, core.op_pc, min(core.op_pc + 15, 0xFFFF), core.op_pc)
+    for start, end in args.hex:
+        print(f"\n${start:04X}-${end:04X}:")
+        hexdump(core.mem, start, end)
+    for start, end in args.dis:
+        print(f"\n${start:04X}-${end:04X}:")
+        disassemble(core.mem, start, end, core.op_pc)
+
+if __name__ == "__main__":
+    main()
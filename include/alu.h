@@ -0,0 +1,87 @@
+#pragma once
+#include <cstdint>
+
+// Table-driven 8-bit ALU. Every result and N/Z/C/V flag set is computed at
+// compile time, so an arithmetic opcode is a table load and a mask instead
+// of a chain of flag tests. Flag bits match CPU::C/Z/V/N.
+namespace alu
+{
+
+constexpr uint8_t C = 1 << 0;
+constexpr uint8_t Z = 1 << 1;
+constexpr uint8_t V = 1 << 6;
+constexpr uint8_t N = 1 << 7;
+constexpr uint8_t NZ = N | Z;
+constexpr uint8_t NZC = N | Z | C;
+constexpr uint8_t NZCV = N | Z | C | V;
+
+struct Out
+{
+    uint8_t r; // result
+    uint8_t f; // flags, only the bits the operation defines
+};
+
+struct Tables
+{
+    uint8_t nz[256];
+    // NZCV for a + b + cin and a - b - !cin (C = no borrow), indexed
+    // [cin][a << 8 | b]. The result is a plain add/subtract.
+    uint8_t add[2][65536];
+    uint8_t sub[2][65536];
+    Out neg[256];
+    Out shl[256];    // logical/arithmetic shift left
+    Out shr[256];    // logical shift right
+    Out asr[256];    // arithmetic shift right (sign kept)
+    Out rol[2][256]; // [cin][value]
+    Out ror[2][256];
+};
+
+constexpr uint8_t nz_of(uint8_t r)
+{
+    return uint8_t((r == 0 ? Z : 0) | (r & N));
+}
+
+constexpr Tables make_tables()
+{
+    Tables t{};
+    for (int v = 0; v < 256; v++)
+    {
+        uint8_t u = uint8_t(v);
+        t.nz[v] = nz_of(u);
+
+        uint8_t n = uint8_t(-v);
+        t.neg[v] = {n, uint8_t(nz_of(n) | (n != 0 ? C : 0) | (((u ^ n) & 0x80) ? V : 0))};
+
+        uint8_t r = uint8_t(u << 1);
+        t.shl[v] = {r, uint8_t(nz_of(r) | (u >> 7))};
+        r = uint8_t(u >> 1);
+        t.shr[v] = {r, uint8_t(nz_of(r) | (u & 1))};
+        r = uint8_t((u >> 1) | (u & 0x80));
+        t.asr[v] = {r, uint8_t(nz_of(r) | (u & 1))};
+        for (int cin = 0; cin < 2; cin++)
+        {
+            r = uint8_t((u << 1) | cin);
+            t.rol[cin][v] = {r, uint8_t(nz_of(r) | (u >> 7))};
+            r = uint8_t((u >> 1) | (cin << 7));
+            t.ror[cin][v] = {r, uint8_t(nz_of(r) | (u & 1))};
+        }
+    }
+    for (int cin = 0; cin < 2; cin++)
+        for (int a = 0; a < 256; a++)
+            for (int b = 0; b < 256; b++)
+            {
+                int sum = a + b + cin;
+                uint8_t r = uint8_t(sum);
+                t.add[cin][a << 8 | b] = uint8_t(nz_of(r) | (sum > 0xFF ? C : 0) |
+                                                 ((~(a ^ b) & (a ^ r) & 0x80) ? V : 0));
+                int diff = a - b - (1 - cin);
+                r = uint8_t(diff);
+                t.sub[cin][a << 8 | b] = uint8_t(nz_of(r) | (diff >= 0 ? C : 0) |
+                                                 (((a ^ b) & (a ^ r) & 0x80) ? V : 0));
+            }
+    return t;
+}
+
+inline constexpr Tables TABLES = make_tables();
+
+} // namespace alu
@@ -0,0 +1,143 @@
+#pragma once
+#include <cstdint>
+#include "alu.h"
+
+// Table-driven packed BCD unit. Conversions and digit arithmetic for the
+// BCD opcodes are generated at compile time; each entry holds the result and
+// the flags the opcode defines, in the CPU flag layout. Every table is its
+// own constant so each stays within the compiler's constexpr budget.
+namespace bcd
+{
+
+struct ByteTable
+{
+    alu::Out e[256];
+};
+
+struct PairTable
+{
+    alu::Out e[65536]; // [a << 8 | b]
+};
+
+constexpr uint8_t z_of(uint8_t r)
+{
+    return r == 0 ? alu::Z : 0;
+}
+
+// DECOD: Z, C = value > 99 (the result clamps to $99).
+constexpr alu::Out to_bcd(int v)
+{
+    int c = v > 99 ? 99 : v;
+    uint8_t r = uint8_t((c / 10) << 4 | (c % 10));
+    return {r, uint8_t(z_of(r) | (v > 99 ? alu::C : 0))};
+}
+
+// DECBIN: Z.
+constexpr alu::Out to_bin(int v)
+{
+    uint8_t r = uint8_t((v >> 4) * 10 + (v & 0x0F));
+    return {r, z_of(r)};
+}
+
+// ADDBCD: a digit carry zeroes the low digit and the high digit saturates
+// at 9 with C and V set.
+constexpr alu::Out add_sat(int a, int b, int)
+{
+    int low = (a & 0x0F) + (b & 0x0F);
+    int high = (a >> 4) + (b >> 4);
+    bool carry = false;
+    if (low > 9)
+    {
+        low = 0;
+        high += 1;
+    }
+    if (high > 9)
+    {
+        high = 9;
+        carry = true;
+    }
+    uint8_t r = uint8_t(high << 4 | (low & 0x0F));
+    return {r, uint8_t(z_of(r) | (r & alu::N) | (carry ? alu::C | alu::V : 0))};
+}
+
+// SUBBCD: a digit borrow zeroes the low digit and the high digit stops at 0
+// with C clear and V set.
+constexpr alu::Out sub_sat(int a, int b, int)
+{
+    int low = (a & 0x0F) - (b & 0x0F);
+    int high = (a >> 4) - (b >> 4);
+    bool borrow = false;
+    if (low < 0)
+    {
+        low = 0;
+        high -= 1;
+    }
+    if (high < 0)
+    {
+        high = 0;
+        borrow = true;
+    }
+    uint8_t r = uint8_t((high & 0x0F) << 4 | (low & 0x0F));
+    return {r, uint8_t(z_of(r) | (r & alu::N) | (borrow ? alu::V : alu::C))};
+}
+
+// Exact two-digit add with carry in/out for DADD: C = carry out, Z of the byte.
+constexpr alu::Out add_dec(int a, int b, int cin)
+{
+    int low = (a & 0x0F) + (b & 0x0F) + cin;
+    int c = low > 9;
+    if (c)
+        low -= 10;
+    int high = (a >> 4) + (b >> 4) + c;
+    c = high > 9;
+    if (c)
+        high -= 10;
+    uint8_t r = uint8_t((high & 0x0F) << 4 | (low & 0x0F));
+    return {r, uint8_t(z_of(r) | (c ? alu::C : 0))};
+}
+
+// Exact two-digit subtract for DSUB: cin and C mean "no borrow".
+constexpr alu::Out sub_dec(int a, int b, int cin)
+{
+    int low = (a & 0x0F) - (b & 0x0F) - (1 - cin);
+    int bw = low < 0;
+    if (bw)
+        low += 10;
+    int high = (a >> 4) - (b >> 4) - bw;
+    bw = high < 0;
+    if (bw)
+        high += 10;
+    uint8_t r = uint8_t((high & 0x0F) << 4 | (low & 0x0F));
+    return {r, uint8_t(z_of(r) | (bw ? 0 : alu::C))};
+}
+
+template <alu::Out (*F)(int)>
+constexpr ByteTable make_byte_table()
+{
+    ByteTable t{};
+    for (int v = 0; v < 256; v++)
+        t.e[v] = F(v);
+    return t;
+}
+
+template <alu::Out (*F)(int, int, int), int CIN>
+constexpr PairTable make_pair_table()
+{
+    PairTable t{};
+    for (int i = 0; i < 65536; i++)
+        t.e[i] = F(i >> 8, i & 0xFF, CIN);
+    return t;
+}
+
+inline constexpr ByteTable TO_BCD = make_byte_table<to_bcd>();
+inline constexpr ByteTable TO_BIN = make_byte_table<to_bin>();
+inline constexpr PairTable ADD = make_pair_table<add_sat, 0>();
+inline constexpr PairTable SUB = make_pair_table<sub_sat, 0>();
+inline constexpr PairTable ADC_C0 = make_pair_table<add_dec, 0>();
+inline constexpr PairTable ADC_C1 = make_pair_table<add_dec, 1>();
+inline constexpr PairTable SBC_C0 = make_pair_table<sub_dec, 0>();
+inline constexpr PairTable SBC_C1 = make_pair_table<sub_dec, 1>();
+inline constexpr const PairTable *ADC[2] = {&ADC_C0, &ADC_C1}; // [carry in]
+inline constexpr const PairTable *SBC[2] = {&SBC_C0, &SBC_C1}; // [no borrow in]
+
+} // namespace bcd
@@ -0,0 +1,46 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Block storage device ($FF40-$FF46). The guest sets a sector number, a
+// buffer address and a sector count, then writes a command to BLK_CMD.
+// The transfer completes asynchronously: the data moves in one go once
+// its cycles have elapsed, and BLK_DONE is raised. The disk is a host
+// file mapped into memory (see MappedFile), so only the sectors the guest
+// touches are paged in and writes go straight back to the file.
+static constexpr uint16_t BLK_CMD = 0xFF40;       // write: command, read: status
+static constexpr uint16_t BLK_SECTOR_0 = 0xFF41;  // sector number, bits 0-7
+static constexpr uint16_t BLK_SECTOR_1 = 0xFF42;  // bits 8-15
+static constexpr uint16_t BLK_SECTOR_2 = 0xFF43;  // bits 16-23
+static constexpr uint16_t BLK_BUF_LO = 0xFF44;    // guest buffer address
+static constexpr uint16_t BLK_BUF_HI = 0xFF45;
+static constexpr uint16_t BLK_COUNT = 0xFF46;     // sectors per transfer, 1-128
+
+static constexpr uint32_t BLK_SECTOR_SIZE = 512;
+static constexpr uint32_t BLK_MAX_COUNT = 128; // 64 KiB, the whole address space
+
+enum : uint8_t
+{
+    BLK_CMD_READ = 1,  // disk -> buffer
+    BLK_CMD_WRITE = 2, // buffer -> disk
+
+    BLK_DONE = 1 << 0,  // status: last command finished (cleared by the next command)
+    BLK_ERROR = 1 << 1, // status: last command failed (no disk, bad count or sector range)
+    BLK_BUSY = 1 << 7   // status: transfer in flight, registers latched
+};
+
+// Emulated transfer time: a fixed access latency plus a per-byte cost.
+static constexpr uint32_t BLK_LATENCY_CYCLES = 2000;
+static constexpr uint32_t BLK_CYCLES_PER_BYTE = 1;
+
+struct BlockDev
+{
+    uint8_t *data = nullptr; // disk image, not owned
+    uint32_t sectors = 0;
+    uint32_t sector = 0;
+    uint16_t buf = 0;
+    uint8_t count = 1;
+    uint8_t cmd = 0;         // command in flight
+    uint8_t status = 0;
+    uint64_t done_at = 0;    // clock value at which the transfer lands
+};
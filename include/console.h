@@ -0,0 +1,106 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// Console device registers ($FF30-$FF31).
+static constexpr uint16_t CON_DATA = 0xFF30;   // write: output a byte, read: take an input byte (0 if none)
+static constexpr uint16_t CON_STATUS = 0xFF31; // read: CON_RX_READY | CON_RX_EOF
+
+enum : uint8_t
+{
+    CON_RX_READY = 1 << 0, // an input byte is waiting
+    CON_RX_EOF = 1 << 1    // input is closed and fully read
+};
+
+// Single-producer, single-consumer byte ring. One side only stores `head`
+// and the other only stores `tail`, so neither ever takes a lock.
+template <uint32_t Size>
+struct ByteRing
+{
+    static_assert((Size & (Size - 1)) == 0, "ring size must be a power of two");
+    uint8_t buf[Size];
+    std::atomic<uint32_t> head{0}; // written by the producer
+    std::atomic<uint32_t> tail{0}; // written by the consumer
+
+    bool push(uint8_t v)
+    {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) == Size)
+            return false;
+        buf[h & (Size - 1)] = v;
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+    int pop()
+    {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        if (t == head.load(std::memory_order_acquire))
+            return -1;
+        uint8_t v = buf[t & (Size - 1)];
+        tail.store(t + 1, std::memory_order_release);
+        return v;
+    }
+    bool empty() const { return tail.load(std::memory_order_acquire) == head.load(std::memory_order_acquire); }
+};
+
+// Buffered console. Guest output goes into a ring that a writer thread
+// drains to stdout or a file in large writes, so a CON_DATA store is a
+// couple of host stores and never a system call. The writer wakes every
+// CONSOLE_FLUSH_MS or when flush() asks; the core only waits if the
+// writer falls a full ring behind.
+//
+// Input is read from stdin by a background thread, started on the first
+// guest access to the input side; CON_DATA reads never block.
+static constexpr int CONSOLE_FLUSH_MS = 10;
+
+struct Console
+{
+    // `out_path` == nullptr writes to stdout. Throws std::runtime_error.
+    explicit Console(const char *out_path = nullptr);
+    Console(const Console &) = delete;
+    Console &operator=(const Console &) = delete;
+    ~Console() { close(); }
+
+    void put(uint8_t v)
+    {
+        while (!out.push(v))
+            wait_for_writer();
+    }
+    int get(); // -1 when no input is waiting
+    uint8_t status();
+
+    void flush(); // blocks until everything put() so far is written
+    void close(); // flushes and stops the writer
+
+private:
+    static constexpr uint32_t OUT_SIZE = 1 << 20;
+    static constexpr uint32_t IN_SIZE = 1 << 12;
+
+    struct Input
+    {
+        ByteRing<IN_SIZE> ring;
+        std::atomic<bool> eof{false};
+    };
+
+    FILE *file = nullptr;
+    bool own_file = false;
+    ByteRing<OUT_SIZE> out;
+    std::thread writer;
+    std::mutex lock;
+    std::condition_variable wake;    // writer: work or stop requested
+    std::condition_variable drained; // flush(): writer caught up
+    bool stopping = false;
+    bool flush_requested = false;
+    uint32_t written = 0; // out.tail after the last completed write
+    std::shared_ptr<Input> in; // shared with the detached reader thread
+
+    void write_loop();
+    void drain();
+    void wait_for_writer();
+    void start_input();
+};
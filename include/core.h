@@ -0,0 +1,21 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+struct CPU;
+
+// Post-mortem core files. A core is a 256-byte header holding the
+// registers, why the run ended, the cycle and instruction counters and the
+// last CPU::PC_HISTORY instruction addresses, followed by the 64 KiB
+// address space at offset CORE_MEM_OFFSET as the CPU sees it
+// (CPU::copy_address_space()): bank windows show their selected bank and
+// device registers show their backing bytes. Header and memory are gathered
+// into one buffer and written with a single fwrite.
+//
+// coreview.py prints the header and hexdumps or disassembles ranges.
+static constexpr uint32_t CORE_VERSION = 1;
+static constexpr size_t CORE_MEM_OFFSET = 256;
+static constexpr size_t CORE_SIZE = CORE_MEM_OFFSET + 65536;
+
+// Throws std::runtime_error.
+void write_core(CPU &cpu, const char *path);
@@ -1,5 +1,18 @@
 #pragma once
 #include <cstdint>
+#include "io.h"
+#include "mmu.h"
+#include "blk.h"
+#include "fb.h"
+
+namespace alu
+{
+struct Out;
+}
+struct Smp;
+struct Console;
+struct OpProfile;
+struct HeatMap;
 
 static constexpr uint16_t STACK_BASE = 0x1200; // start of stack page
 
@@ -13,9 +26,161 @@ struct CPU
     uint8_t P = 0; // bit0=C, bit1=Z, bit6=V, bit7=N
     uint32_t cycles = 0;
     bool _halted = false; // for faster emualtion only
+    bool quiet = false;   // no [HALT]/[STACK] messages (fuzzing)
+    uint16_t op_pc = 0;   // address of the instruction being executed
+    uint64_t clock = 0;   // total elapsed cycles, one per step()
+    uint64_t instret = 0; // instructions executed
+
+    // Addresses of the last PC_HISTORY instructions, the newest at
+    // pc_history[instret % PC_HISTORY]. Written to core files (core.h).
+    static constexpr uint32_t PC_HISTORY = 32;
+    uint16_t pc_history[PC_HISTORY]{};
+
+    // Memory. `mem` normally points at mem_buf; load_state() can point it
+    // at a copy-on-write mapping of a saved image instead, and SMP cores
+    // all point it at one shared buffer. The stack page is reached through
+    // stack_mem, which SMP cores point at their own mem_buf so each core
+    // has a private stack.
+    uint8_t mem_buf[65536]{};
+    uint8_t *mem = mem_buf;
+    uint8_t *stack_mem = mem_buf + STACK_BASE;
+
+    // Per-page access flags. A non-zero entry sends read()/write() for that
+    // page through read_slow()/write_slow(); all other pages are plain
+    // array accesses.
+    enum : uint16_t
+    {
+        PAGE_IO = 1 << 0,    // device registers
+        PAGE_STACK = 1 << 1, // stack page (writes drop the shadow stack; reads on SMP cores)
+        PAGE_BANK = 1 << 2,  // inside a bank window
+        PAGE_BREAK = 1 << 3, // has a breakpoint (page_read only)
+        PAGE_WATCH = 1 << 4, // has a watchpoint
+        PAGE_TRACK = 1 << 5, // first write records the page in dirty_pages (page_write only)
+        PAGE_WAIT = 1 << 6,  // has memory wait states (TIMING_WAIT_STATES)
+        PAGE_SHARED = 1 << 7, // SMP shared page: acquire loads, release stores
+        PAGE_HEAT = 1 << 8,   // accesses are counted in the heatmap (all pages while attached)
+        PAGE_FRAME = 1 << 9   // framebuffer page not yet written this frame (page_write only)
+    };
+    uint16_t page_read[256]{};
+    uint16_t page_write[256]{};
+
+    // Pages written since PAGE_TRACK was set on them, so a snapshot can be
+    // restored by copying back only those pages.
+    uint8_t dirty_pages[256]{};
+    uint16_t dirty_count = 0;
+
+    // Timing model (timing.h), fixed at construction. TIMING_FIXED charges
+    // CYCLES[op] per instruction; TIMING_WAIT_STATES adds per-page wait
+    // states for every memory access the instruction makes.
+    enum TimingModel : uint8_t
+    {
+        TIMING_FIXED,
+        TIMING_WAIT_STATES
+    };
+    uint8_t timing_model = TIMING_FIXED;
+    uint8_t wait_read[256]{};  // extra cycles per read, by page
+    uint8_t wait_write[256]{}; // extra cycles per write, by page
+    uint32_t access_wait = 0;  // wait cycles accrued by the current instruction
+
+    // Devices
+    Dma dma;
+    Mmu mmu;
+    BlockDev blk;
+    Framebuffer fb;
+    Console *console = nullptr; // CON_DATA/CON_STATUS; plain RAM when not attached
+    uint64_t next_event = UINT64_MAX; // earliest clock a device needs service
+
+    // Stack checking: when set, a push with SP=$00 or a pop with SP=$FF
+    // halts the CPU with a stack fault instead of wrapping around the page.
+    // Set it with set_stack_checked(); stack_slow is the single test pushes
+    // and pops make for it and for the heatmap.
+    bool stack_checked = false;
+    bool stack_slow = false;
+
+    enum Fault : uint8_t
+    {
+        FAULT_NONE = 0,
+        FAULT_STACK_OVERFLOW,
+        FAULT_STACK_UNDERFLOW,
+        FAULT_UNKNOWN_OPCODE
+    };
+    uint8_t fault = FAULT_NONE;
+    uint16_t fault_pc = 0; // op_pc of the instruction that faulted
+    bool trap_unknown = false; // unknown opcodes fault instead of running as NOP
+
+    // Why _halted is set. Breakpoints and watchpoints stop the core the same
+    // way HALT does so run loops need no extra check; resume() continues.
+    enum Stop : uint8_t
+    {
+        STOP_NONE = 0,
+        STOP_HALT,       // HALT opcode
+        STOP_FAULT,      // see fault
+        STOP_BREAKPOINT, // about to execute a breakpoint address (PC)
+        STOP_WATCHPOINT  // the last instruction touched watch_addr
+    };
+    uint8_t stop = STOP_NONE;
+
+    // Breakpoints and watchpoints, one bit per address. Only pages that
+    // hold one are flagged, so with none set the core runs exactly as fast
+    // as without a debugger.
+    uint64_t bp_bits[1024]{};
+    uint64_t watch_read_bits[1024]{};
+    uint64_t watch_write_bits[1024]{};
+    int32_t bp_resume_pc = -1; // breakpoint to step over once after resume()
+    uint16_t watch_addr = 0;
+    bool watch_was_write = false;
 
-    // Memory
-    uint8_t mem[65536]{};
+    // SMP (smp.h). Cores of one Smp share memory and each run on their own
+    // host thread; a single CPU has smp == nullptr and sees core 0 of 1.
+    Smp *smp = nullptr;
+    uint8_t core_id = 0;
+    uint8_t mbox_target = 0;      // MBOX_TARGET register
+    bool mbox_send_failed = false; // last MBOX_SEND found the target's mailbox full
+
+    // Edge coverage for the fuzzer. When cov_map is set, every branch,
+    // jump, call and return bumps the counter for the edge from the
+    // previous block into the one it lands on.
+    static constexpr uint32_t COV_MAP_SIZE = 1 << 14;
+    uint8_t *cov_map = nullptr;
+    uint16_t cov_prev = 0;
+
+    // Superinstructions (superop.h). SUPEROP_PROFILE counts opcode pairs
+    // and triples into op_profile; SUPEROP_FUSE runs fused pairs in one
+    // dispatch under TIMING_FIXED. A fused pair has no instruction
+    // boundary between its halves, so single-stepping and per-step tracing
+    // leave this off.
+    enum : uint8_t
+    {
+        SUPEROP_OFF,
+        SUPEROP_PROFILE,
+        SUPEROP_FUSE
+    };
+    uint8_t superop = SUPEROP_OFF;
+    OpProfile *op_profile = nullptr;
+
+    // Memory heatmap (heat.h); nullptr and no PAGE_HEAT flags when off.
+    HeatMap *heat = nullptr;
+    bool heat_paused = false; // set while a DMA or disk transfer lands; not CPU accesses
+
+    // Shadow return-address stack. Calls record what they pushed and the SP
+    // after the push; a return whose SP matches the top entry takes its
+    // target from here instead of re-reading the stack page. Any write that
+    // can touch a recorded slot (a store into the stack page, or a data push
+    // above the top entry) empties it, and returns fall back to memory.
+    enum : uint8_t
+    {
+        RAS_RET16, // JSR/BSR/JSRI return address
+        RAS_RET8   // BRR return offset
+    };
+    struct RasEntry
+    {
+        uint8_t sp;
+        uint8_t kind;
+        uint16_t value;
+    };
+    static constexpr int RAS_SIZE = 32;
+    RasEntry ras[RAS_SIZE];
+    uint8_t ras_top = 0; // number of valid entries
 
     // Flag bits
     enum
@@ -31,19 +196,86 @@ struct CPU
     };
 
     // Methods
+    explicit CPU(uint8_t timing = TIMING_FIXED);
+    CPU(const CPU &) = delete; // mem may point into this object
+    CPU &operator=(const CPU &) = delete;
     void reset(uint16_t start_addr);
     void step();
+    template <uint8_t Model>
+    void step_model();
+    void set_wait_states(uint16_t start, uint16_t end, uint8_t read_wait, uint8_t write_wait);
+    void set_stack_checked(bool on);
     void run(); // Run Until Halt
+    template <class Cond>
+    uint8_t run_until(Cond &&cond); // run.h
 
     // Helpers
-    uint8_t read(uint16_t addr) const;
+    uint8_t read(uint16_t addr);
     void write(uint16_t addr, uint8_t val);
+    uint8_t read_slow(uint16_t addr);
+    void write_slow(uint16_t addr, uint8_t val);
+    bool pages_flagged(const uint16_t *flags, uint16_t addr, uint32_t len, uint16_t mask = 0xFFFF) const;
+    void block_copy(uint16_t dst, uint16_t src, uint32_t len);
+    void block_fill(uint16_t dst, uint8_t val, uint32_t len);
+    void bcd_block(uint16_t dst, uint16_t src, uint16_t len, bool subtract);
+
+    // Devices (io.cpp)
+    uint8_t io_read(uint16_t addr);
+    void io_write(uint16_t addr, uint8_t val);
+    void run_events();
+    void schedule_events();
+
+    // Debugging (debug.cpp)
+    void set_breakpoint(uint16_t addr, bool on);
+    void set_watchpoint(uint16_t addr, bool on_read, bool on_write);
+    bool hit_breakpoint();
+    void check_watch(uint16_t addr, bool is_write);
+    void resume();
+    void cover_edge();
+
+    // Heatmap (heat.cpp)
+    void attach_heatmap(HeatMap *map);
+    void heat_access(uint16_t addr, bool is_write);
+
+    // Superinstructions (cpu.cpp)
+    bool superop_step(uint8_t op);
+    bool run_fused(uint8_t op);
+    bool fuse_continue(uint8_t first, uint8_t second);
+
+    // Bank switching (mmu.cpp)
+    void map_banks(uint8_t *backing, size_t size, uint16_t base, uint32_t window_size, int windows);
+    void select_bank(int window, uint8_t bank);
+    uint8_t *host_ptr(uint16_t addr);
+    void copy_address_space(uint8_t *out);
+
+    // Block device (blk.cpp)
+    void attach_disk(uint8_t *data, size_t size);
+    void blk_command(uint8_t cmd);
+    void blk_complete();
+
+    // Framebuffer (fb.cpp)
+    void attach_framebuffer(FrameSink *sink, uint32_t interval);
+    void fb_mark(uint16_t addr);
+    void fb_palette_write(uint8_t val);
+    void fb_frame();
+
+    // SMP (smp.cpp)
+    uint8_t *atomic_ptr(uint16_t addr);
+
+    // Core helpers (cpu.cpp)
     void setNZ(uint8_t val);
-    void setAddFlags(uint8_t a, uint8_t b, uint16_t res);
-    void setSubFlags(uint8_t a, uint8_t b, uint16_t res);
+    uint8_t add8(uint8_t a, uint8_t b, int cin);
+    uint8_t sub8(uint8_t a, uint8_t b, int cin);
+    uint8_t alu_out(const alu::Out &o, uint8_t mask);
     void push8(uint8_t value);
     void setFlag(int flag, bool cond);
     uint8_t pop8();
+    void stack_fault(uint8_t kind);
+    void unknown_opcode(uint8_t op);
+    void call_push16(uint16_t ret);
+    uint16_t ret_pop16();
+    void ras_record(uint8_t kind, uint16_t value);
+    uint8_t *stack_page() { return stack_mem; }
     uint16_t break_addr;
     uint8_t fetch8();
     uint16_t read16();
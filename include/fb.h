@@ -0,0 +1,65 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+struct FrameSink;
+
+// Framebuffer: FB_WIDTH x FB_HEIGHT pixels, one byte each, at FB_BASE in
+// guest memory, shown through a 256-entry RGB palette. The palette is
+// loaded through FB_PAL_INDEX/FB_PAL_DATA (R, G, B per entry, the index
+// advancing after B) and starts out as RGB 3-3-2.
+static constexpr uint16_t FB_BASE = 0xC000;
+static constexpr uint32_t FB_WIDTH = 128;
+static constexpr uint32_t FB_HEIGHT = 96;
+static constexpr uint32_t FB_SIZE = FB_WIDTH * FB_HEIGHT; // $C000-$EFFF
+static constexpr uint32_t FB_PAGES = FB_SIZE / 256;
+
+static constexpr uint16_t FB_PAL_INDEX = 0xFF50; // palette entry to load
+static constexpr uint16_t FB_PAL_DATA = 0xFF51;  // write R, G, B in turn
+static constexpr uint16_t FB_FRAME = 0xFF52;     // read: frames emitted so far (low byte)
+
+// Writes reach the device through the page tables: the framebuffer pages
+// carry PAGE_FRAME, and the first write to one after a frame marks its
+// rows dirty and clears the flag, so later writes in the same frame are
+// plain stores. At each frame boundary only the dirty rows are converted
+// to RGB, and a frame in which nothing was written is not encoded or
+// written at all.
+struct Framebuffer
+{
+    FrameSink *sink = nullptr;        // not owned; nullptr = device off
+    uint32_t interval = 0;            // cycles per frame
+    uint64_t next_frame = UINT64_MAX;
+    uint32_t frame = 0;
+    uint64_t dirty = 0;               // bit n = framebuffer page n written
+    uint8_t pal_index = 0;
+    uint8_t pal_component = 0;
+    uint8_t palette[256][3];
+    uint8_t rgb[FB_SIZE * 3];         // last encoded frame
+};
+
+// Where frames go. Binary PPM files (DIR/frame_NNNNNN.ppm, numbered by
+// emulated frame, so gaps are frames that did not change) or a raw RGB24
+// stream, which has to carry every frame to keep its rate: an unchanged
+// frame repeats the previous frame's bytes without re-encoding.
+struct FrameSink
+{
+    enum Kind
+    {
+        SINK_PPM,
+        SINK_RAW
+    };
+
+    FrameSink(Kind kind, const char *path); // throws std::runtime_error
+    FrameSink(const FrameSink &) = delete;
+    FrameSink &operator=(const FrameSink &) = delete;
+    ~FrameSink();
+
+    void write(uint32_t frame, const uint8_t *rgb, bool changed);
+    uint32_t written = 0; // frames actually written
+
+private:
+    Kind kind;
+    std::string path;
+    FILE *raw = nullptr;
+};
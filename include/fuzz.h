@@ -0,0 +1,26 @@
+#pragma once
+#include <cstdint>
+
+struct CPU;
+
+// Coverage-guided fuzzing of a guest program. The ROM runs from reset up
+// to `start_pc` once; that state is snapshotted and every exec restores it,
+// writes a mutated input to [input_addr, input_addr + input_max) and runs
+// until HALT, a fault or `max_cycles`. Inputs that reach new edges are
+// added to the corpus directory; faults go to <corpus>/crashes and inputs
+// that hit the cycle limit to <corpus>/hangs.
+struct FuzzConfig
+{
+    const char *corpus_dir = nullptr;
+    uint16_t input_addr = 0;
+    uint16_t input_max = 256;
+    int32_t len_addr = -1;   // if set, input length is stored here (16-bit LE)
+    int32_t start_pc = -1;   // injection point; default is the reset PC
+    uint64_t max_cycles = 100000;
+    uint64_t max_execs = 0;  // 0 = run until interrupted
+    uint64_t seed = 0;       // 0 = seed from the clock
+};
+
+// Runs the fuzzer on a CPU that has been loaded and reset. Throws
+// std::runtime_error on a bad configuration or corpus directory.
+void fuzz(CPU &cpu, const FuzzConfig &cfg);
@@ -0,0 +1,49 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+struct CPU;
+
+// GDB remote serial protocol server. Exposes A, X, SP, P (one byte each)
+// and PC (two bytes, little endian), in that order, plus memory, software
+// breakpoints, watchpoints, single-step and continue.
+//
+// Continue runs the core with plain step() calls; stops come from the
+// core's own breakpoint/watchpoint machinery, so the debugger only polls
+// the connection for an interrupt every GDB_POLL_CYCLES cycles.
+static constexpr uint32_t GDB_POLL_CYCLES = 1 << 16;
+// Largest packet accepted or sent, advertised in qSupported. Memory reads
+// and writes are limited so their hex data fits in one.
+static constexpr uint32_t GDB_PACKET_SIZE = 0x4000;
+
+struct GdbStub
+{
+    explicit GdbStub(CPU &cpu) : cpu(cpu) {}
+    GdbStub(const GdbStub &) = delete;
+    GdbStub &operator=(const GdbStub &) = delete;
+    ~GdbStub() { close(); }
+
+    // Waits for a debugger on `spec`: a TCP port on localhost ("1234") or
+    // a Unix socket ("unix:/tmp/cpu.sock"). Throws std::runtime_error.
+    void listen(const char *spec);
+    // Handles packets until the debugger detaches or kills the session.
+    void serve();
+    void close();
+
+private:
+    CPU &cpu;
+    intptr_t sock = -1;
+    intptr_t listener = -1;
+    std::string unix_path;
+
+    bool get_packet(std::string &out);
+    void put_packet(const std::string &data);
+    bool interrupted();
+    std::string handle(const std::string &pkt, bool &done);
+    std::string stop_reply() const;
+    std::string resume(bool single);
+    std::string read_regs() const;
+    void write_regs(const std::string &hex);
+    std::string read_mem(uint32_t addr, uint32_t len);
+    void write_mem(uint32_t addr, uint32_t len, const std::string &hex);
+};
@@ -0,0 +1,58 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+// Memory access heatmap and working-set analyzer. While attached
+// (CPU::attach_heatmap()), every page carries PAGE_HEAT, so all reads and
+// writes take the slow path and are counted there, per page and per
+// address. Pushes and pops are counted through the stack's checked path.
+// Nothing is set up while detached, so the fast paths are unchanged.
+//
+// An access is code when it reads the bytes of the instruction being
+// executed (opcode and operands), stack when it is a push or pop or
+// touches the stack page, and data otherwise.
+//
+// The working set is the number of distinct pages and bytes touched in
+// each window of `window` cycles.
+struct HeatMap
+{
+    enum Kind : uint8_t
+    {
+        CODE,
+        DATA_READ,
+        DATA_WRITE,
+        STACK_READ,
+        STACK_WRITE,
+        KINDS
+    };
+
+    struct Window
+    {
+        uint64_t start; // first cycle
+        uint32_t pages;
+        uint32_t bytes;
+    };
+
+    explicit HeatMap(uint32_t window);
+
+    void record(uint16_t addr, uint8_t kind, uint64_t clock);
+    void finish(); // closes the last window
+    void save(const char *path) const; // throws std::runtime_error
+    void summary(FILE *out) const;
+
+    uint64_t pages[256][KINDS]{};
+    std::unique_ptr<uint64_t[][KINDS]> bytes; // [addr][kind]
+    std::vector<Window> windows;
+
+private:
+    void next_window(uint64_t clock);
+
+    uint32_t window;
+    uint64_t window_end;
+    uint32_t window_id = 1; // stamps below are this window's when equal
+    uint32_t page_seen[256]{};
+    std::unique_ptr<uint32_t[]> byte_seen;
+    Window current{0, 0, 0};
+};
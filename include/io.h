@@ -0,0 +1,37 @@
+#pragma once
+#include <cstdint>
+
+// Memory-mapped device page ($FF00-$FFFF). Every access to it goes through
+// CPU::io_read()/CPU::io_write() instead of plain memory.
+static constexpr uint16_t IO_BASE = 0xFF00;
+
+// DMA controller ($FF00-$FF07)
+static constexpr uint16_t DMA_SRC_LO = 0xFF00;
+static constexpr uint16_t DMA_SRC_HI = 0xFF01;
+static constexpr uint16_t DMA_DST_LO = 0xFF02;
+static constexpr uint16_t DMA_DST_HI = 0xFF03;
+static constexpr uint16_t DMA_LEN_LO = 0xFF04;
+static constexpr uint16_t DMA_LEN_HI = 0xFF05;
+static constexpr uint16_t DMA_FILL = 0xFF06; // fill value for DMA_MODE_FILL
+static constexpr uint16_t DMA_CTRL = 0xFF07; // write: start, read: status
+
+enum : uint8_t
+{
+    DMA_START = 1 << 0,     // write 1 to start a transfer
+    DMA_MODE_FILL = 1 << 1, // fill DST with FILL instead of copying from SRC
+    DMA_BUSY = 1 << 7       // set while a transfer is in flight
+};
+
+// Emulated cost of a DMA transfer. The copy itself happens on the host in
+// one go once the transfer's cycles have elapsed.
+static constexpr uint32_t DMA_CYCLES_PER_BYTE = 1;
+
+struct Dma
+{
+    uint16_t src = 0;
+    uint16_t dst = 0;
+    uint16_t len = 0;
+    uint8_t fill = 0;
+    uint8_t ctrl = 0;
+    uint64_t done_at = 0; // clock value at which the transfer lands
+};
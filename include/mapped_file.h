@@ -0,0 +1,38 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// A host file mapped into memory. Used for bank backing stores, save
+// states and block devices so large images are paged in by the OS instead
+// of being read up front.
+struct MappedFile
+{
+    enum Mode
+    {
+        MAP_READ,        // read-only view
+        MAP_SHARED,      // read/write, changes go back to the file
+        MAP_COPY_ON_WRITE // read/write, changes stay private to this process
+    };
+
+    uint8_t *data = nullptr;
+    size_t size = 0;
+
+    MappedFile() = default;
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    ~MappedFile() { close(); }
+
+    // Maps `path`. With min_size > 0 and MAP_SHARED, the file is created or
+    // grown to at least that many bytes first. Throws std::runtime_error.
+    void open(const char *path, Mode mode, size_t min_size = 0);
+    void close();
+    void sync(); // flush MAP_SHARED changes to the file
+
+private:
+#ifdef _WIN32
+    void *file_handle = nullptr;
+    void *map_handle = nullptr;
+#else
+    int fd = -1;
+#endif
+};
@@ -0,0 +1,25 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Bank select registers, one per window ($FF10-$FF13). Writing a bank
+// number maps that bank into the window; reading returns the current bank.
+static constexpr uint16_t BANK_SEL = 0xFF10;
+static constexpr int MMU_MAX_WINDOWS = 4;
+
+// Bank-switched memory. Up to MMU_MAX_WINDOWS consecutive windows of
+// 4, 8 or 16 KiB starting at `base` are backed by a host buffer (or mapped
+// file) holding up to 256 banks. Switching a bank only swaps the window
+// pointer; the pages under the windows are flagged so only they pay for
+// the indirection.
+struct Mmu
+{
+    uint8_t *backing = nullptr; // host memory holding all banks, not owned
+    size_t banks = 0;
+    uint16_t base = 0;          // address of window 0
+    uint32_t window_size = 0;
+    uint8_t shift = 0;          // log2(window_size)
+    int windows = 0;
+    uint8_t select[MMU_MAX_WINDOWS]{};
+    uint8_t *window[MMU_MAX_WINDOWS]{}; // backing + select * window_size
+};
@@ -0,0 +1,40 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+
+// Locks emulation to a nominal guest clock. The caller runs the CPU in
+// quanta of cycles and calls wait() after each; the pacer sleeps until the
+// wall-clock deadline for that cycle count. Deadlines are absolute from the
+// start, so sleep overshoot in one quantum is absorbed by the next instead
+// of accumulating as drift. When the host falls further behind than
+// `max_lag`, the pacer re-anchors to now and counts a slip rather than
+// running flat out to catch up.
+struct Pacer
+{
+    using clock = std::chrono::steady_clock;
+
+    Pacer(double hz, uint32_t quantum_us);
+
+    uint64_t quantum_cycles() const { return quantum; }
+    void start(uint64_t cycle);
+    void wait(uint64_t cycle);
+    void report() const; // prints target vs achieved speed and jitter
+
+private:
+    double hz;
+    uint64_t quantum;
+    clock::duration max_lag;
+    clock::time_point anchor_time;
+    uint64_t anchor_cycle = 0;
+    clock::time_point start_time;
+    uint64_t start_cycle = 0;
+    uint64_t last_cycle = 0;
+
+    // Stats
+    uint64_t waits = 0;
+    uint64_t late_waits = 0; // deadline already passed when the quantum ended
+    uint64_t slips = 0;
+    double jitter_sum_us = 0; // |wake time - deadline| over sleeps
+    double jitter_max_us = 0;
+    uint64_t sleeps = 0;
+};
@@ -1,3 +1,4 @@
+#include <cstddef>
 #include <cstdint>
 #include <vector>
 
@@ -8,4 +9,5 @@ struct Rom {
 };
 
 Rom load_rom(const char* path);
+Rom parse_rom(const uint8_t* buf, size_t size);
 void clear_rom(Rom* rom);
\ No newline at end of file
@@ -0,0 +1,204 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include "cpu.h"
+
+// Stop conditions for CPU::run_until(). run_until() is instantiated per
+// condition type, so the checks are inlined into its loop. A condition
+// provides:
+//
+//   void begin(const CPU &)        called once, before running
+//   uint64_t horizon(const CPU &)  the clock up to which it cannot fire
+//   uint8_t fired(CPU &)           its RunStop reason once it has fired, or RUN_NONE
+//   EVERY_INSTRUCTION              whether fired() must also be asked at
+//                                  every instruction boundary
+//
+// Conditions without EVERY_INSTRUCTION cost one clock compare per step:
+// the loop runs plain step() calls up to the nearest horizon and only
+// then asks them. The core always stops on HALT, faults, breakpoints and
+// watchpoints as well (RUN_HALT; CPU::stop says which).
+//
+// An instruction boundary is a step after which cycles == 0, so the next
+// step fetches. Boundary conditions are only tested after at least one
+// step, so a run always makes progress. A fused pair (--fuse) has no
+// boundary between its two instructions.
+enum RunStop : uint8_t
+{
+    RUN_NONE,
+    RUN_HALT,         // the core stopped; see CPU::stop
+    RUN_CYCLES,       // cycle budget used up
+    RUN_INSTRUCTIONS, // instruction budget used up, at the next boundary
+    RUN_PC,           // reached an address in the PC set
+    RUN_MEMORY        // the memory predicate became true
+};
+
+// No condition of its own: runs until the core stops.
+struct UntilHalt
+{
+    static constexpr bool EVERY_INSTRUCTION = false;
+    void begin(const CPU &) {}
+    uint64_t horizon(const CPU &) const { return UINT64_MAX; }
+    uint8_t fired(CPU &) const { return RUN_NONE; }
+};
+
+// Runs `cycles` cycles (steps).
+struct CycleBudget
+{
+    static constexpr bool EVERY_INSTRUCTION = false;
+    explicit CycleBudget(uint64_t cycles) : cycles(cycles) {}
+    void begin(const CPU &cpu) { end = cpu.clock + cycles; }
+    uint64_t horizon(const CPU &) const { return end; }
+    uint8_t fired(CPU &cpu) const { return cpu.clock >= end ? RUN_CYCLES : RUN_NONE; }
+
+    uint64_t cycles;
+    uint64_t end = 0;
+};
+
+// Runs until the clock reaches `end`.
+struct UntilCycle
+{
+    static constexpr bool EVERY_INSTRUCTION = false;
+    explicit UntilCycle(uint64_t end) : end(end) {}
+    void begin(const CPU &) {}
+    uint64_t horizon(const CPU &) const { return end; }
+    uint8_t fired(CPU &cpu) const { return cpu.clock >= end ? RUN_CYCLES : RUN_NONE; }
+
+    uint64_t end;
+};
+
+// Runs `count` more instructions and the cycles of the last one, stopping
+// on the boundary after it. An instruction takes at least one step, so
+// the horizon is as many steps as instructions are left. A fused pair can
+// overshoot the budget by one.
+struct InstructionBudget
+{
+    static constexpr bool EVERY_INSTRUCTION = false;
+    explicit InstructionBudget(uint64_t count) : count(count) {}
+    void begin(const CPU &cpu) { end = cpu.instret + count; }
+    uint64_t horizon(const CPU &cpu) const
+    {
+        return cpu.instret < end ? cpu.clock + (end - cpu.instret) : cpu.clock + cpu.cycles;
+    }
+    uint8_t fired(CPU &cpu) const
+    {
+        return cpu.instret >= end && cpu.cycles == 0 ? RUN_INSTRUCTIONS : RUN_NONE;
+    }
+
+    uint64_t count;
+    uint64_t end = 0;
+};
+
+// Stops at a boundary where PC is `addr`.
+struct AtPc
+{
+    static constexpr bool EVERY_INSTRUCTION = true;
+    explicit AtPc(uint16_t addr) : addr(addr) {}
+    void begin(const CPU &) {}
+    uint64_t horizon(const CPU &) const { return UINT64_MAX; }
+    uint8_t fired(CPU &cpu) const { return cpu.cycles == 0 && cpu.PC == addr ? RUN_PC : RUN_NONE; }
+
+    uint16_t addr;
+};
+
+// Stops at a boundary where PC is in the set, one bit per address.
+struct PcSet
+{
+    static constexpr bool EVERY_INSTRUCTION = true;
+    PcSet() = default;
+    explicit PcSet(uint16_t addr) { add(addr); }
+    void add(uint16_t addr) { bits[addr >> 6] |= uint64_t(1) << (addr & 63); }
+    void begin(const CPU &) {}
+    uint64_t horizon(const CPU &) const { return UINT64_MAX; }
+    uint8_t fired(CPU &cpu) const
+    {
+        return cpu.cycles == 0 && (bits[cpu.PC >> 6] >> (cpu.PC & 63) & 1) ? RUN_PC : RUN_NONE;
+    }
+
+    uint64_t bits[1024]{};
+};
+
+// Stops at a boundary where pred(byte at addr) is true. The byte is read
+// from memory directly, without device side effects.
+template <class Pred>
+struct MemoryMatch
+{
+    static constexpr bool EVERY_INSTRUCTION = true;
+    MemoryMatch(uint16_t addr, Pred pred) : addr(addr), pred(pred) {}
+    void begin(const CPU &) {}
+    uint64_t horizon(const CPU &) const { return UINT64_MAX; }
+    uint8_t fired(CPU &cpu) const
+    {
+        return cpu.cycles == 0 && pred(*cpu.host_ptr(addr)) ? RUN_MEMORY : RUN_NONE;
+    }
+
+    uint16_t addr;
+    Pred pred;
+};
+
+template <class Pred>
+MemoryMatch<Pred> memory_match(uint16_t addr, Pred pred)
+{
+    return MemoryMatch<Pred>(addr, pred);
+}
+
+// Stops when any of its conditions fires; the first one listed wins ties.
+template <class... Conds>
+struct AnyOf
+{
+    static constexpr bool EVERY_INSTRUCTION = (Conds::EVERY_INSTRUCTION || ...);
+    explicit AnyOf(Conds... conds) : conds(conds...) {}
+    void begin(const CPU &cpu)
+    {
+        std::apply([&](auto &...c) { (c.begin(cpu), ...); }, conds);
+    }
+    uint64_t horizon(const CPU &cpu) const
+    {
+        return std::apply([&](const auto &...c) { return std::min({c.horizon(cpu)...}); }, conds);
+    }
+    uint8_t fired(CPU &cpu) const
+    {
+        uint8_t reason = RUN_NONE;
+        std::apply([&](const auto &...c) { ((reason = c.fired(cpu)) || ...); }, conds);
+        return reason;
+    }
+
+    std::tuple<Conds...> conds;
+};
+
+template <class... Conds>
+AnyOf<Conds...> any_of(Conds... conds)
+{
+    return AnyOf<Conds...>(conds...);
+}
+
+template <class Cond>
+uint8_t CPU::run_until(Cond &&cond)
+{
+    cond.begin(*this);
+    for (;;)
+    {
+        uint64_t end = cond.horizon(*this);
+        if constexpr (std::decay_t<Cond>::EVERY_INSTRUCTION)
+        {
+            while (!_halted && clock < end)
+            {
+                step();
+                if (cycles == 0)
+                    if (uint8_t reason = cond.fired(*this))
+                        return reason;
+            }
+        }
+        else
+        {
+            while (!_halted && clock < end)
+                step();
+        }
+        if (_halted)
+            return RUN_HALT;
+        if (uint8_t reason = cond.fired(*this))
+            return reason;
+    }
+}
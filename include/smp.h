@@ -0,0 +1,73 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "cpu.h"
+
+// Per-core registers ($FF20-$FF25). On a single CPU they read as core 0 of
+// 1 with an empty mailbox, and every send fails.
+static constexpr uint16_t CORE_ID = 0xFF20;     // read: this core's number
+static constexpr uint16_t CORE_COUNT = 0xFF21;  // read: number of cores
+static constexpr uint16_t MBOX_TARGET = 0xFF22; // core MBOX_SEND delivers to
+static constexpr uint16_t MBOX_SEND = 0xFF23;   // write: post a byte to the target's mailbox
+static constexpr uint16_t MBOX_STATUS = 0xFF24; // read: MBOX_RX_FULL | MBOX_TX_FAILED
+static constexpr uint16_t MBOX_RECV = 0xFF25;   // read: take the byte in this core's mailbox (0 if empty)
+
+enum : uint8_t
+{
+    MBOX_RX_FULL = 1 << 0,  // this core's mailbox holds a byte
+    MBOX_TX_FAILED = 1 << 1 // the last send found the target's mailbox full
+};
+
+// Guest bytes accessed atomically in place. Only atomic opcodes, shared
+// pages and mailboxes use this; ordinary accesses stay plain loads and
+// stores.
+static_assert(sizeof(std::atomic<uint8_t>) == 1 && std::atomic<uint8_t>::is_always_lock_free,
+              "guest bytes must be usable as lock-free atomics");
+inline std::atomic<uint8_t> &atomic_byte(uint8_t *p)
+{
+    return *reinterpret_cast<std::atomic<uint8_t> *>(p);
+}
+
+// Symmetric multiprocessing: `count` cores sharing one 64 KiB memory, each
+// run on its own host thread by run(). Every core keeps its own registers,
+// stack page, devices and debug state; everything else in the address
+// space is the same host memory.
+//
+// Plain accesses are unsynchronized host loads and stores, exactly as on a
+// single core, so cores only pay for synchronization where the guest asks
+// for it: the atomic opcodes (TAS, CAS, FENCE), pages marked with
+// set_shared() (acquire loads, release stores) and the mailbox registers.
+struct Smp
+{
+    static constexpr int MAX_CORES = 16;
+
+    Smp(int count, uint8_t timing = CPU::TIMING_FIXED);
+    Smp(const Smp &) = delete;
+    Smp &operator=(const Smp &) = delete;
+
+    int count() const { return int(cores.size()); }
+    CPU &core(int i) { return *cores[i]; }
+
+    // Copies `data` to `origin` in shared memory (and into every core's
+    // private stack page where it overlaps) and resets all cores there.
+    void load(uint16_t origin, const std::vector<uint8_t> &data);
+    void set_shared(uint16_t start, uint16_t end);
+
+    // Runs every core on its own thread until all have halted or each has
+    // run `max_cycles` more cycles.
+    void run(uint64_t max_cycles);
+
+    // Mailboxes: one byte per core. send() fails when the target's mailbox
+    // is still full.
+    bool send(int to, uint8_t value);
+    bool pending(int core) const;
+    uint8_t receive(int core);
+
+private:
+    std::vector<uint8_t> memory;
+    std::vector<std::unique_ptr<CPU>> cores;
+    static constexpr uint16_t MBOX_FULL = 0x100;
+    std::unique_ptr<std::atomic<uint16_t>[]> mailbox; // MBOX_FULL | byte
+};
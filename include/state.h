@@ -0,0 +1,29 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+struct CPU;
+struct MappedFile;
+
+// Machine images ("save states"). An image is a 4 KiB header holding the
+// registers, cycle counters, DMA and block device registers and the
+// framebuffer's frame counter, next frame time and palette, followed
+// by the full 64 KiB address space at offset STATE_MEM_OFFSET. All-zero
+// 4 KiB chunks are left as holes, so on filesystems with sparse files an
+// image only takes the space of the memory the program actually uses. The
+// disk image is not part of the state; a resumed run attaches it again.
+//
+// load_state() maps the image copy-on-write and points CPU::mem into the
+// mapping: nothing is read up front, pages are faulted in as the guest
+// touches them, and guest writes never reach the file. The MappedFile must
+// outlive the CPU's use of that memory, like a bank backing store. Attach
+// the disk and framebuffer before loading.
+static constexpr uint32_t STATE_VERSION = 3;
+static constexpr size_t STATE_MEM_OFFSET = 4096;
+static constexpr size_t STATE_CHUNK = 4096;
+static constexpr size_t STATE_SIZE = STATE_MEM_OFFSET + 65536;
+
+// Both throw std::runtime_error. Bank-switched machines are not supported:
+// their banks live outside the 64 KiB image.
+void save_state(const CPU &cpu, const char *path);
+void load_state(CPU &cpu, MappedFile &image, const char *path);
@@ -0,0 +1,48 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <unordered_map>
+
+// Superinstructions. With CPU::superop set to SUPEROP_PROFILE the core
+// counts how often each opcode is followed by each other opcode, pairs and
+// triples, along straight-line code; --profile-ops prints the hottest
+// sequences. The hottest pairs found that way in code.s and bench/ are
+// built into the core as fused handlers (CPU::run_fused() in cpu.cpp),
+// which SUPEROP_FUSE enables: the second instruction of a pair runs in the
+// same dispatch as the first, and a flag write the second one overwrites
+// is not made at all. Triples are only reported, never fused.
+//
+// The second opcode is read from memory every time the first one executes,
+// so code that rewrites it is never run as the old pair.
+struct OpProfile
+{
+    uint64_t ops = 0;
+    uint64_t pairs[65536]{}; // [first << 8 | second]
+    std::unordered_map<uint32_t, uint64_t> triples; // first << 16 | second << 8 | third
+
+    // `control` is IS_CONTROL for op: a sequence only continues past an
+    // opcode that falls through to the next one.
+    void record(uint8_t op, bool control);
+    void report(FILE *out, size_t top) const;
+
+private:
+    uint8_t last[2] = {0, 0}; // last[0] is the previous opcode
+    uint8_t run = 0;          // how many of last[] continue into the next opcode
+};
+
+// Opcode pairs with a fused handler, as first << 8 | second.
+enum : uint16_t
+{
+    FUSE_LDA_STA = 0x090A, // copy a byte
+    FUSE_LDA_LDX = 0x090E, // load both operands (LDA's flags are overwritten)
+    FUSE_LDA_DEC = 0x0903, // count down a variable (LDA's flags are overwritten)
+    FUSE_STA_LDA = 0x0A09,
+    FUSE_STA_BNZ = 0x0A05, // store the count and loop
+    FUSE_LDI_STA = 0x500A, // initialise a variable
+    FUSE_DEC_BNZ = 0x0305, // count down A
+    FUSE_SUBF_BZ = 0x2906, // compare and branch
+    FUSE_PHA_PHX = 0x2C2E, // save A and X
+    FUSE_PLX_PLA = 0x2F2D, // restore them (PLX's flags are overwritten)
+};
+extern const uint16_t FUSED_PAIRS[];
+extern const size_t FUSED_PAIR_COUNT;
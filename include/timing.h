@@ -0,0 +1,33 @@
+#pragma once
+#include <cstdint>
+#include "cpu.h"
+
+// Timing models. CPU::step() is instantiated once per model and picks the
+// instantiation from CPU::timing_model, which is fixed when the CPU is
+// constructed. A model turns the opcode's base cost from CYCLES[] into the
+// cycles charged for the instruction.
+template <uint8_t Model>
+struct Timing;
+
+// Fixed cost per opcode. Compiles to exactly the table lookup step() has
+// always done.
+template <>
+struct Timing<CPU::TIMING_FIXED>
+{
+    static uint32_t cost(CPU &, uint8_t, uint32_t base) { return base; }
+};
+
+// Base cost plus memory wait states. Every access through read()/write()
+// to a page with wait states adds them to access_wait (see read_slow()),
+// so operand fetches, data accesses and block transfers are all charged
+// for the regions they touch and the addressing mode's access count.
+template <>
+struct Timing<CPU::TIMING_WAIT_STATES>
+{
+    static uint32_t cost(CPU &cpu, uint8_t, uint32_t base)
+    {
+        uint32_t wait = cpu.access_wait;
+        cpu.access_wait = 0;
+        return base + wait;
+    }
+};
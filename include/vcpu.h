@@ -0,0 +1,77 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// C API for embedding the CPU (libvcpu). Everything goes through an opaque
+// handle so the ABI does not change when struct CPU does. Functions that can
+// fail return 0 on success and -1 on error; vcpu_last_error() has the
+// message. Handles are not thread-safe, but separate handles are
+// independent.
+
+#if defined(_WIN32)
+#ifdef VCPU_BUILD
+#define VCPU_API __declspec(dllexport)
+#else
+#define VCPU_API __declspec(dllimport)
+#endif
+#else
+#define VCPU_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct vcpu vcpu;
+
+enum vcpu_reg
+{
+    VCPU_REG_A = 0,
+    VCPU_REG_X = 1,
+    VCPU_REG_SP = 2,
+    VCPU_REG_P = 3,
+    VCPU_REG_PC = 4
+};
+
+// Why vcpu_run() returned. Matches CPU::Stop.
+enum vcpu_stop
+{
+    VCPU_STOP_NONE = 0, // cycle budget used up
+    VCPU_STOP_HALT,
+    VCPU_STOP_FAULT,
+    VCPU_STOP_BREAKPOINT,
+    VCPU_STOP_WATCHPOINT
+};
+
+VCPU_API vcpu *vcpu_create(void);
+VCPU_API void vcpu_destroy(vcpu *v);
+VCPU_API const char *vcpu_last_error(const vcpu *v);
+
+// Loads an MR8C ROM image from memory and resets to its origin.
+VCPU_API int vcpu_load_rom(vcpu *v, const uint8_t *image, size_t size);
+// Copies raw bytes into guest memory at `addr`.
+VCPU_API int vcpu_load(vcpu *v, uint16_t addr, const uint8_t *data, size_t size);
+VCPU_API void vcpu_reset(vcpu *v, uint16_t pc);
+
+// Runs for up to `cycles` cycles, returning early on a stop. Returns a
+// vcpu_stop; after a breakpoint or watchpoint the next call continues.
+VCPU_API int vcpu_run(vcpu *v, uint64_t cycles);
+VCPU_API int vcpu_step(vcpu *v); // one instruction
+VCPU_API uint64_t vcpu_clock(const vcpu *v);
+
+VCPU_API uint16_t vcpu_get_reg(const vcpu *v, int reg);
+VCPU_API void vcpu_set_reg(vcpu *v, int reg, uint16_t value);
+
+// The 64 KiB guest address space, valid until vcpu_destroy(). Reads and
+// writes through it are plain memory: no device side effects, and bank
+// windows show the memory underneath rather than the selected bank.
+VCPU_API uint8_t *vcpu_memory(vcpu *v);
+#define VCPU_MEMORY_SIZE 65536
+
+VCPU_API void vcpu_set_breakpoint(vcpu *v, uint16_t addr, int on);
+VCPU_API void vcpu_set_watchpoint(vcpu *v, uint16_t addr, int on_read, int on_write);
+VCPU_API void vcpu_set_stack_checked(vcpu *v, int on);
+
+#ifdef __cplusplus
+}
+#endif
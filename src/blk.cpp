@@ -0,0 +1,59 @@
+#include "cpu.h"
+#include <string.h>
+
+// Attaches a disk image of `size` bytes; a partial last sector is ignored.
+// The image must outlive the CPU.
+void CPU::attach_disk(uint8_t *data, size_t size)
+{
+    blk.data = data;
+    size_t sectors = size / BLK_SECTOR_SIZE;
+    blk.sectors = sectors > 0xFFFFFF ? 0xFFFFFF : uint32_t(sectors);
+}
+
+// BLK_CMD write. Bad requests fail at once; good ones complete after
+// BLK_LATENCY_CYCLES plus the per-byte cost, in blk_complete().
+void CPU::blk_command(uint8_t cmd)
+{
+    if (blk.status & BLK_BUSY)
+        return; // registers are latched until the transfer lands
+    bool valid = blk.data && (cmd == BLK_CMD_READ || cmd == BLK_CMD_WRITE) && blk.count >= 1 &&
+                 blk.count <= BLK_MAX_COUNT && uint64_t(blk.sector) + blk.count <= blk.sectors;
+    if (!valid)
+    {
+        blk.status = BLK_DONE | BLK_ERROR;
+        return;
+    }
+    blk.cmd = cmd;
+    blk.status = BLK_BUSY;
+    blk.done_at = clock + BLK_LATENCY_CYCLES + uint64_t(blk.count) * BLK_SECTOR_SIZE * BLK_CYCLES_PER_BYTE;
+    schedule_events();
+}
+
+// Moves the data of the transfer in flight. Buffers in plain memory are a
+// single memcpy; anything that wraps past $FFFF or touches a flagged page
+// goes byte by byte through read()/write(), as block_copy() does. The
+// transfer is not a CPU access, so PAGE_HEAT alone keeps the memcpy.
+void CPU::blk_complete()
+{
+    uint8_t *disk = blk.data + size_t(blk.sector) * BLK_SECTOR_SIZE;
+    uint32_t len = uint32_t(blk.count) * BLK_SECTOR_SIZE;
+    const uint16_t *flags = blk.cmd == BLK_CMD_READ ? page_write : page_read;
+    bool plain = uint32_t(blk.buf) + len <= 0x10000 && !pages_flagged(flags, blk.buf, len, uint16_t(~PAGE_HEAT));
+    if (blk.cmd == BLK_CMD_READ)
+    {
+        if (plain)
+            memcpy(mem + blk.buf, disk, len);
+        else
+            for (uint32_t i = 0; i < len; i++)
+                write(uint16_t(blk.buf + i), disk[i]);
+    }
+    else
+    {
+        if (plain)
+            memcpy(disk, mem + blk.buf, len);
+        else
+            for (uint32_t i = 0; i < len; i++)
+                disk[i] = read(uint16_t(blk.buf + i));
+    }
+    blk.status = BLK_DONE;
+}
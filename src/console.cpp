@@ -0,0 +1,126 @@
+#include "console.h"
+#include <chrono>
+#include <stdexcept>
+#include <string>
+
+Console::Console(const char *out_path)
+{
+    file = stdout;
+    if (out_path)
+    {
+        file = std::fopen(out_path, "wb");
+        if (!file)
+            throw std::runtime_error(std::string("Cannot open ") + out_path);
+        own_file = true;
+    }
+    writer = std::thread(&Console::write_loop, this);
+}
+
+void Console::write_loop()
+{
+    std::unique_lock<std::mutex> g(lock);
+    for (;;)
+    {
+        wake.wait_for(g, std::chrono::milliseconds(CONSOLE_FLUSH_MS),
+                      [this] { return stopping || flush_requested; });
+        bool stop = stopping;
+        flush_requested = false;
+        g.unlock();
+        drain();
+        g.lock();
+        written = out.tail.load(std::memory_order_relaxed);
+        drained.notify_all();
+        if (stop)
+            return;
+    }
+}
+
+// Writes everything in the ring, as at most two contiguous chunks.
+void Console::drain()
+{
+    uint32_t t = out.tail.load(std::memory_order_relaxed);
+    uint32_t h = out.head.load(std::memory_order_acquire);
+    if (t == h)
+        return;
+    while (t != h)
+    {
+        uint32_t off = t & (OUT_SIZE - 1);
+        uint32_t n = h - t < OUT_SIZE - off ? h - t : OUT_SIZE - off;
+        std::fwrite(out.buf + off, 1, n, file);
+        t += n;
+        out.tail.store(t, std::memory_order_release);
+    }
+    std::fflush(file);
+}
+
+// The ring is full: get the writer going and give it the CPU.
+void Console::wait_for_writer()
+{
+    {
+        std::lock_guard<std::mutex> g(lock);
+        flush_requested = true;
+    }
+    wake.notify_one();
+    std::this_thread::yield();
+}
+
+void Console::flush()
+{
+    std::unique_lock<std::mutex> g(lock);
+    if (!writer.joinable())
+        return;
+    uint32_t target = out.head.load(std::memory_order_relaxed);
+    flush_requested = true;
+    wake.notify_one();
+    drained.wait(g, [&] { return int32_t(written - target) >= 0; });
+}
+
+void Console::close()
+{
+    if (writer.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> g(lock);
+            stopping = true;
+        }
+        wake.notify_one();
+        writer.join();
+    }
+    if (own_file && file)
+        std::fclose(file);
+    file = nullptr;
+    own_file = false;
+}
+
+// Input is read a byte at a time on a detached thread, which may stay
+// blocked in stdin after the console is gone; it only touches the Input
+// it shares ownership of.
+void Console::start_input()
+{
+    in = std::make_shared<Input>();
+    std::shared_ptr<Input> q = in;
+    std::thread([q] {
+        int c;
+        while ((c = std::fgetc(stdin)) != EOF)
+            while (!q->ring.push(uint8_t(c)))
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        q->eof.store(true, std::memory_order_release);
+    }).detach();
+}
+
+int Console::get()
+{
+    if (!in)
+        start_input();
+    return in->ring.pop();
+}
+
+uint8_t Console::status()
+{
+    if (!in)
+        start_input();
+    bool eof = in->eof.load(std::memory_order_acquire); // first: it is set after the last push
+    if (!in->ring.empty())
+        return CON_RX_READY;
+    return eof ? CON_RX_EOF : 0;
+}
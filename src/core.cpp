@@ -0,0 +1,75 @@
+#include "core.h"
+#include "cpu.h"
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+// Header layout, little endian. Everything after the last field up to
+// CORE_MEM_OFFSET is zero. A core of a run that did not halt (the step
+// limit ran out) has H_HALTED clear.
+enum : size_t
+{
+    H_MAGIC = 0,        // "MR8D"
+    H_VERSION = 4,      // u16
+    H_HISTORY = 6,      // u16, valid entries in H_PC_HISTORY
+    H_A = 8,
+    H_X = 9,
+    H_SP = 10,
+    H_P = 11,
+    H_PC = 12,          // u16
+    H_OP_PC = 14,       // u16
+    H_HALTED = 16,
+    H_STOP = 17,
+    H_FAULT = 18,
+    H_FAULT_PC = 20,    // u16
+    H_CYCLES = 24,      // u32, cycles left on the current instruction
+    H_CLOCK = 32,       // u64
+    H_INSTRET = 40,     // u64
+    H_PC_HISTORY = 64   // u16[CPU::PC_HISTORY], oldest first
+};
+static_assert(H_PC_HISTORY + 2 * CPU::PC_HISTORY <= CORE_MEM_OFFSET, "core header overflow");
+
+static void put(uint8_t *p, uint64_t v, int bytes)
+{
+    for (int i = 0; i < bytes; i++)
+        p[i] = uint8_t(v >> (8 * i));
+}
+
+void write_core(CPU &cpu, const char *path)
+{
+    std::unique_ptr<uint8_t[]> image(new uint8_t[CORE_SIZE]());
+    uint8_t *h = image.get();
+    std::memcpy(h + H_MAGIC, "MR8D", 4);
+    put(h + H_VERSION, CORE_VERSION, 2);
+    h[H_A] = cpu.A;
+    h[H_X] = cpu.X;
+    h[H_SP] = cpu.SP;
+    h[H_P] = cpu.P;
+    put(h + H_PC, cpu.PC, 2);
+    put(h + H_OP_PC, cpu.op_pc, 2);
+    h[H_HALTED] = cpu._halted;
+    h[H_STOP] = cpu.stop;
+    h[H_FAULT] = cpu.fault;
+    put(h + H_FAULT_PC, cpu.fault_pc, 2);
+    put(h + H_CYCLES, cpu.cycles, 4);
+    put(h + H_CLOCK, cpu.clock, 8);
+    put(h + H_INSTRET, cpu.instret, 8);
+
+    // Unroll the ring, oldest entry first.
+    uint32_t count = cpu.instret < CPU::PC_HISTORY ? uint32_t(cpu.instret) : CPU::PC_HISTORY;
+    put(h + H_HISTORY, count, 2);
+    for (uint32_t i = 0; i < count; i++)
+        put(h + H_PC_HISTORY + 2 * i, cpu.pc_history[(cpu.instret - count + 1 + i) % CPU::PC_HISTORY], 2);
+
+    cpu.copy_address_space(h + CORE_MEM_OFFSET);
+
+    FILE *f = std::fopen(path, "wb");
+    if (!f)
+        throw std::runtime_error(std::string("Cannot create ") + path);
+    bool ok = std::fwrite(h, 1, CORE_SIZE, f) == CORE_SIZE;
+    ok = std::fclose(f) == 0 && ok;
+    if (!ok)
+        throw std::runtime_error(std::string("Cannot write ") + path);
+}
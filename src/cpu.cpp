@@ -1,5 +1,14 @@
 #include "cpu.h"
+#include "alu.h"
+#include "bcd.h"
+#include "timing.h"
+#include "smp.h"
+#include "superop.h"
+#include "heat.h"
+#include "console.h"
+#include "run.h"
 #include <stdio.h>
+#include <string.h>
 
 // Cycle counts for each opcode (0x00–0xFF)
 // Unused opcodes default to 0 cycles for now.
@@ -84,10 +93,61 @@ static const uint8_t CYCLES[256] = {
     /*0x4D*/ 2,   // NIBSWAP
     /*0x4E*/ 2,   // NIBSWAPX
     /*0x4F*/ 3,   // MIXAX
-    // ... fill remaining unused opcodes with 2 cycles for now ...
-    [0xFF] = 2 // HALT
+    /*0x50*/ 0,   // LDI
+    /*0x51*/ 6,   // BMOV (+1 per byte)
+    /*0x52*/ 6,   // BFILL (+1 per byte)
+    /*0x53*/ 8,   // MUL
+    /*0x54*/ 12,  // DIV
+    /*0x55*/ 12,  // MOD
+    /*0x56*/ 6,   // ADD16
+    /*0x57*/ 6,   // SUB16
+    /*0x58*/ 6,   // DADD (+1 per byte)
+    /*0x59*/ 6,   // DSUB (+1 per byte)
+    /*0x5A*/ 6,   // TAS
+    /*0x5B*/ 7,   // CAS
+    /*0x5C*/ 3,   // FENCE
+    // 0x5D-0xFE unused
+    /*0x5D-0x5F*/ 0, 0, 0,
+    /*0x60-0x6F*/ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    /*0x70-0x7F*/ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    /*0x80-0x8F*/ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    /*0x90-0x9F*/ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    /*0xA0-0xAF*/ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    /*0xB0-0xBF*/ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    /*0xC0-0xCF*/ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    /*0xD0-0xDF*/ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    /*0xE0-0xEF*/ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    /*0xF0-0xFE*/ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    /*0xFF*/ 2    // HALT
 };
 
+// Opcodes that can change control flow (branches, jumps, calls, returns).
+// Only these record coverage edges.
+static const bool IS_CONTROL[256] = {
+    /*0x00*/ 0, 0, 0, 0, 1, 1, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0,
+    /*0x10*/ 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0,
+    /*0x20*/ 0, 0, 0, 0, 0, 1, 1, 1, 0, 0, 1, 1, 0, 0, 0, 0,
+    /*0x30*/ 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 1, 1, 1,
+    /*0x40*/ 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+};
+
+// Opcodes that start a fused pair (superop.h): operand bytes before the
+// second opcode, plus one. Zero for all others.
+static const uint8_t FUSE_FIRST[256] = {
+    /*0x00*/ 0, 0, 0, 1, 0, 0, 0, 0, 0, 3, 3, 0, 0, 0, 0, 0,
+    /*0x10*/ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    /*0x20*/ 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 0, 0, 1,
+    /*0x30*/ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    /*0x40*/ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    /*0x50*/ 3,
+};
+
+void CPU::set_stack_checked(bool on)
+{
+    stack_checked = on;
+    stack_slow = on || heat;
+}
+
 void CPU::reset(uint16_t start_addr)
 {
     A = X = 0;
@@ -95,19 +155,285 @@ void CPU::reset(uint16_t start_addr)
     P = 0;
     PC = start_addr;
     _halted = false;
+    fault = FAULT_NONE;
+    stop = STOP_NONE;
+    bp_resume_pc = -1;
+    ras_top = 0;
     P &= ~H;
 }
 
-uint8_t CPU::read(uint16_t addr) const
+CPU::CPU(uint8_t timing) : timing_model(timing)
+{
+    page_read[IO_BASE >> 8] |= PAGE_IO;
+    page_write[IO_BASE >> 8] |= PAGE_IO;
+    page_write[STACK_BASE >> 8] |= PAGE_STACK;
+}
+
+uint8_t CPU::read(uint16_t addr)
 {
+    if (page_read[addr >> 8])
+        return read_slow(addr);
     return mem[addr];
 }
 
 void CPU::write(uint16_t addr, uint8_t val)
 {
+    if (page_write[addr >> 8])
+        return write_slow(addr, val);
+    mem[addr] = val;
+}
+
+uint8_t CPU::read_slow(uint16_t addr)
+{
+    uint16_t flags = page_read[addr >> 8];
+    if (flags & PAGE_HEAT)
+        heat_access(addr, false);
+    if (flags & PAGE_WAIT)
+        access_wait += wait_read[addr >> 8];
+    if (flags & PAGE_WATCH)
+        check_watch(addr, false);
+    if (flags & PAGE_IO)
+        return io_read(addr);
+    if (flags & PAGE_SHARED)
+        return atomic_byte(mem + addr).load(std::memory_order_acquire);
+    if (flags & PAGE_STACK)
+        return stack_page()[addr & 0xFF];
+    if (flags & PAGE_BANK)
+        return *host_ptr(addr);
+    return mem[addr];
+}
+
+void CPU::write_slow(uint16_t addr, uint8_t val)
+{
+    uint16_t flags = page_write[addr >> 8];
+    if (flags & PAGE_HEAT)
+        heat_access(addr, true);
+    if (flags & PAGE_FRAME)
+        fb_mark(addr);
+    if (flags & PAGE_TRACK)
+    {
+        page_write[addr >> 8] &= ~PAGE_TRACK;
+        dirty_pages[dirty_count++] = addr >> 8;
+    }
+    if (flags & PAGE_WAIT)
+        access_wait += wait_write[addr >> 8];
+    if (flags & PAGE_WATCH)
+        check_watch(addr, true);
+    if (flags & PAGE_IO)
+        return io_write(addr, val);
+    if (flags & PAGE_SHARED)
+    {
+        atomic_byte(mem + addr).store(val, std::memory_order_release);
+        return;
+    }
+    if (flags & PAGE_STACK)
+    {
+        ras_top = 0; // may overwrite a recorded return address
+        stack_page()[addr & 0xFF] = val;
+        return;
+    }
+    if (flags & PAGE_BANK)
+    {
+        *host_ptr(addr) = val;
+        return;
+    }
     mem[addr] = val;
 }
 
+// True if any page touched by [addr, addr+len) has a flag in `mask` set.
+bool CPU::pages_flagged(const uint16_t *flags, uint16_t addr, uint32_t len, uint16_t mask) const
+{
+    if (len == 0)
+        return false;
+    uint32_t first = addr >> 8;
+    uint32_t last = (uint32_t(addr) + len - 1) >> 8;
+    for (uint32_t page = first; page <= last; page++)
+        if (flags[page & 0xFF] & mask)
+            return true;
+    return false;
+}
+
+// Block transfers used by BMOV/BFILL and the DMA controller. Ranges that
+// stay inside plain memory are a single memmove/memset; anything that wraps
+// past $FFFF or touches a flagged page is done byte by byte through
+// read()/write() so devices and the shadow stack observe every access.
+void CPU::block_copy(uint16_t dst, uint16_t src, uint32_t len)
+{
+    if (uint32_t(src) + len <= 0x10000 && uint32_t(dst) + len <= 0x10000 &&
+        !pages_flagged(page_read, src, len) && !pages_flagged(page_write, dst, len))
+    {
+        memmove(mem + dst, mem + src, len);
+        return;
+    }
+    if (dst > src && dst < src + len)
+    {
+        // Overlapping forward move: copy from the end like memmove does.
+        for (uint32_t i = len; i-- > 0;)
+            write(uint16_t(dst + i), read(uint16_t(src + i)));
+        return;
+    }
+    for (uint32_t i = 0; i < len; i++)
+        write(uint16_t(dst + i), read(uint16_t(src + i)));
+}
+
+// Multi-byte packed BCD add/subtract for DADD/DSUB: dst = dst +/- src over
+// `len` bytes, least significant byte first. C is the final carry (or no
+// borrow), Z is set if every result byte is zero.
+void CPU::bcd_block(uint16_t dst, uint16_t src, uint16_t len, bool subtract)
+{
+    int carry = subtract ? 1 : 0; // subtract starts with "no borrow"
+    uint8_t any = 0;
+    for (uint16_t i = 0; i < len; i++)
+    {
+        uint16_t d = uint16_t(dst + i);
+        int idx = read(d) << 8 | read(uint16_t(src + i));
+        const alu::Out &o = subtract ? bcd::SBC[carry]->e[idx] : bcd::ADC[carry]->e[idx];
+        write(d, o.r);
+        carry = o.f & C;
+        any |= o.r;
+    }
+    P = (P & ~(Z | C)) | (any ? 0 : Z) | carry;
+}
+
+void CPU::block_fill(uint16_t dst, uint8_t val, uint32_t len)
+{
+    if (uint32_t(dst) + len <= 0x10000 && !pages_flagged(page_write, dst, len))
+    {
+        memset(mem + dst, val, len);
+        return;
+    }
+    for (uint32_t i = 0; i < len; i++)
+        write(uint16_t(dst + i), val);
+}
+
+// The stack always lives in the fixed page at STACK_BASE, so pushes and pops
+// index it directly instead of going through read()/write().
+inline void CPU::push8(uint8_t value)
+{
+    if (stack_slow)
+    {
+        if (stack_checked && SP == 0x00)
+        {
+            stack_fault(FAULT_STACK_OVERFLOW);
+            return;
+        }
+        if (heat)
+            heat->record(uint16_t(STACK_BASE + SP), HeatMap::STACK_WRITE, clock);
+    }
+    // Writing above the newest return address overwrites a recorded slot.
+    if (ras_top && SP > ras[ras_top - 1].sp)
+        ras_top = 0;
+    stack_page()[SP--] = value;
+}
+
+inline uint8_t CPU::pop8()
+{
+    if (stack_slow)
+    {
+        if (stack_checked && SP == 0xFF)
+        {
+            stack_fault(FAULT_STACK_UNDERFLOW);
+            return 0;
+        }
+        if (heat)
+            heat->record(uint16_t(STACK_BASE + uint8_t(SP + 1)), HeatMap::STACK_READ, clock);
+    }
+    return stack_page()[++SP];
+}
+
+inline void CPU::ras_record(uint8_t kind, uint16_t value)
+{
+    if (ras_top == RAS_SIZE)
+    {
+        // Drop the oldest entry; returns that deep fall back to memory.
+        for (int i = 1; i < RAS_SIZE; i++)
+            ras[i - 1] = ras[i];
+        ras_top--;
+    }
+    ras[ras_top++] = {SP, kind, value};
+}
+
+// Push a return address (high byte first) in one go and record it in the
+// shadow stack.
+inline void CPU::call_push16(uint16_t ret)
+{
+    if (stack_slow || SP < 2 || (ras_top && SP > ras[ras_top - 1].sp))
+    {
+        push8((ret >> 8) & 0xFF);
+        push8(ret & 0xFF);
+        if (_halted || SP >= 0xFE || heat)
+        {
+            ras_top = 0; // faulted or wrapped around the page: don't predict;
+            return;      // the heatmap has to see the return's pops
+        }
+    }
+    else
+    {
+        uint8_t *stack = stack_page();
+        stack[SP] = (ret >> 8) & 0xFF;
+        stack[SP - 1] = ret & 0xFF;
+        SP -= 2;
+    }
+    ras_record(RAS_RET16, ret);
+}
+
+// Pop a return address pushed by call_push16, predicted by the shadow stack
+// when nothing has written over it since.
+inline uint16_t CPU::ret_pop16()
+{
+    if (ras_top)
+    {
+        const RasEntry &top = ras[ras_top - 1];
+        if (top.sp == SP && top.kind == RAS_RET16)
+        {
+            ras_top--;
+            SP += 2;
+            return top.value;
+        }
+        ras_top = 0; // out of sync with the guest stack
+    }
+    uint8_t lo = pop8();
+    uint8_t hi = pop8();
+    return (uint16_t(hi) << 8) | lo;
+}
+
+// Guest output still in the console ring goes out before the core's own
+// messages, so they appear in the order they happened.
+static void flush_console(CPU &cpu)
+{
+    if (cpu.console)
+        cpu.console->flush();
+}
+
+void CPU::stack_fault(uint8_t kind)
+{
+    fault = kind;
+    fault_pc = op_pc;
+    stop = STOP_FAULT;
+    _halted = true;
+    P |= H;
+    if (!quiet)
+    {
+        flush_console(*this);
+        printf("[STACK] %s at address 0x%04X (SP=0x%02X)\n",
+               kind == FAULT_STACK_OVERFLOW ? "Overflow" : "Underflow", op_pc, SP);
+    }
+}
+
+void CPU::unknown_opcode(uint8_t op)
+{
+    fault = FAULT_UNKNOWN_OPCODE;
+    fault_pc = op_pc;
+    stop = STOP_FAULT;
+    _halted = true;
+    P |= H;
+    if (!quiet)
+    {
+        flush_console(*this);
+        printf("[HALT] Unknown opcode 0x%02X at address 0x%04X\n", op, op_pc);
+    }
+}
+
 // Reads the next byte from memory and increments PC
 uint8_t CPU::fetch8()
 {
@@ -117,7 +443,7 @@ uint8_t CPU::fetch8()
 }
 
 // Reads the next two bytes (little-endian) and increments PC by 2
-uint16_t CPU::read16()
+inline uint16_t CPU::read16()
 {
     uint8_t low = read(PC);
     uint8_t high = read(PC + 1);
@@ -125,44 +451,33 @@ uint16_t CPU::read16()
     return static_cast<uint16_t>(low) | (static_cast<uint16_t>(high) << 8);
 }
 
-void CPU::setNZ(uint8_t val)
+static_assert(CPU::C == alu::C && CPU::Z == alu::Z && CPU::V == alu::V && CPU::N == alu::N,
+              "ALU tables use the CPU flag layout");
+
+inline void CPU::setNZ(uint8_t val)
 {
-    if (val == 0)
-        P |= Z;
-    else
-        P &= ~Z;
-    if (val & 0x80)
-        P |= N;
-    else
-        P &= ~N;
+    P = (P & ~alu::NZ) | alu::TABLES.nz[val];
 }
 
-void CPU::setAddFlags(uint8_t a, uint8_t b, uint16_t res)
+// A + b + cin with NZCV from the ALU tables. Flags only; callers store the result.
+inline uint8_t CPU::add8(uint8_t a, uint8_t b, int cin)
 {
-    setNZ(uint8_t(res));
-    if (res > 0xFF)
-        P |= C;
-    else
-        P &= ~C;
-    uint8_t r = uint8_t(res);
-    if (~(a ^ b) & (a ^ r) & 0x80)
-        P |= V;
-    else
-        P &= ~V;
+    P = (P & ~alu::NZCV) | alu::TABLES.add[cin][a << 8 | b];
+    return uint8_t(a + b + cin);
 }
 
-void CPU::setSubFlags(uint8_t a, uint8_t b, uint16_t res)
+// a - b - !cin (C = no borrow in and out).
+inline uint8_t CPU::sub8(uint8_t a, uint8_t b, int cin)
 {
-    setNZ(uint8_t(res));
-    if (res < 0x100)
-        P |= C;
-    else
-        P &= ~C; // carry = no borrow
-    uint8_t r = uint8_t(res);
-    if ((a ^ b) & (a ^ r) & 0x80)
-        P |= V;
-    else
-        P &= ~V;
+    P = (P & ~alu::NZCV) | alu::TABLES.sub[cin][a << 8 | b];
+    return uint8_t(a - b - (1 - cin));
+}
+
+// Applies a unary table entry: sets the flags in `mask` and returns the result.
+inline uint8_t CPU::alu_out(const alu::Out &o, uint8_t mask)
+{
+    P = (P & ~mask) | o.f;
+    return o.r;
 }
 
 /**
@@ -171,10 +486,17 @@ void CPU::setSubFlags(uint8_t a, uint8_t b, uint16_t res)
  */
 void CPU::run()
 {
-    while (!_halted || PC == 65535)
-    {
-        step();
-    }
+    run_until(UntilHalt());
+}
+
+// Called with op fetched and PC on its operand. Returns true when op has
+// been executed here, as the first half of a fused pair.
+inline bool CPU::superop_step(uint8_t op)
+{
+    if (superop == SUPEROP_FUSE)
+        return FUSE_FIRST[op] && run_fused(op);
+    op_profile->record(op, IS_CONTROL[op]);
+    return false;
 }
 
 /**
@@ -183,6 +505,7 @@ void CPU::run()
  */
 void CPU::step()
 {
+    clock++;
 
     if (cycles > 0)
     {
@@ -190,27 +513,43 @@ void CPU::step()
         return;
     } // still penalty
 
+    if (timing_model == TIMING_FIXED)
+        step_model<TIMING_FIXED>();
+    else
+        step_model<TIMING_WAIT_STATES>();
+}
+
+// Executes one instruction under timing model `Model`.
+template <uint8_t Model>
+void CPU::step_model()
+{
+    // Devices keep running while the core is halted.
+    if (clock >= next_event)
+        run_events();
+
     if (_halted)
         return;
 
+    // Same table entry read() tests for the fetch, so unflagged pages pay nothing extra.
+    if (page_read[PC >> 8] && hit_breakpoint())
+        return;
+
+    op_pc = PC;
     uint8_t op = read(PC++);
+    instret++;
+    pc_history[instret % PC_HISTORY] = op_pc;
+
+    if (superop && superop_step(op))
+        return;
 
     switch (op)
     {
     case 0x00: // ADD: A = A + X
-    {
-        uint16_t res = uint16_t(A) + uint16_t(X);
-        setAddFlags(A, X, res);
-        A = uint8_t(res);
-    }
-    break;
+        A = add8(A, X, 0);
+        break;
     case 0x01: // SUB: A = A - X
-    {
-        uint16_t res = uint16_t(A) - uint16_t(X);
-        setSubFlags(A, X, res & 0x1FF);
-        A = uint8_t(res);
-    }
-    break;
+        A = sub8(A, X, 1);
+        break;
     case 0x02: // INC: A++
         A++;
         setNZ(A);
@@ -310,8 +649,7 @@ void CPU::step()
 
         // Push return address = address of last byte of JSR
         uint16_t ret = PC - 1;
-        push8((ret >> 8) & 0xFF); // high byte first
-        push8(ret & 0xFF);
+        call_push16(ret); // high byte first
 
         PC = target;
     }
@@ -319,9 +657,7 @@ void CPU::step()
 
     case 0x11: // RTS
     {
-        uint8_t lo = pop8();
-        uint8_t hi = pop8();
-        PC = ((uint16_t(hi) << 8) | lo) + 1; // +1 to move past the JSR
+        PC = ret_pop16() + 1; // +1 to move past the JSR
     }
     break;
 
@@ -332,8 +668,7 @@ void CPU::step()
 
         // Push return address (address of last byte of BSR)
         uint16_t ret = PC; // return to instruction after BSR
-        push8((ret >> 8) & 0xFF);
-        push8(ret & 0xFF);
+        call_push16(ret);
 
         PC = target;
     }
@@ -412,60 +747,20 @@ void CPU::step()
     break;
 
     case 0x19: // XSRA
-    {
-        uint8_t val = X;
-        uint8_t carry = val & 0x01;
-        val >>= 1;
-        A = val;
-        P = (P & ~(N | Z | C)) | (carry ? C : 0);
-        if (A == 0)
-            P |= Z;
-        if (A & 0x80)
-            P |= N;
-    }
-    break;
+        A = alu_out(alu::TABLES.shr[X], alu::NZC);
+        break;
 
     case 0x1A: // XSLA
-    {
-        uint8_t val = X;
-        uint8_t carry = (val >> 7) & 0x01;
-        val <<= 1;
-        A = val;
-        P = (P & ~(N | Z | C)) | (carry ? C : 0);
-        if (A == 0)
-            P |= Z;
-        if (A & 0x80)
-            P |= N;
-    }
-    break;
+        A = alu_out(alu::TABLES.shl[X], alu::NZC);
+        break;
 
     case 0x1B: // ASRX
-    {
-        uint8_t val = A;
-        uint8_t carry = val & 0x01;
-        val >>= 1;
-        X = val;
-        P = (P & ~(N | Z | C)) | (carry ? C : 0);
-        if (X == 0)
-            P |= Z;
-        if (X & 0x80)
-            P |= N;
-    }
-    break;
+        X = alu_out(alu::TABLES.shr[A], alu::NZC);
+        break;
 
     case 0x1C: // ASLX
-    {
-        uint8_t val = A;
-        uint8_t carry = (val >> 7) & 0x01;
-        val <<= 1;
-        X = val;
-        P = (P & ~(N | Z | C)) | (carry ? C : 0);
-        if (X == 0)
-            P |= Z;
-        if (X & 0x80)
-            P |= N;
-    }
-    break;
+        X = alu_out(alu::TABLES.shl[A], alu::NZC);
+        break;
 
     case 0x1D: // AND
         A = A & X;
@@ -514,13 +809,27 @@ void CPU::step()
         ret_offset = -offset; // so RTR can add it back
 
         push8((uint8_t)ret_offset); // store as unsigned byte
+        if (SP != 0xFF && !heat)
+            ras_record(RAS_RET8, (uint8_t)ret_offset);
+        else
+            ras_top = 0; // wrapped around the page, or the heatmap has to see RTR's pop
         PC = uint16_t(PC + offset);
     }
     break;
 
     case 0x26: // RTR
     {
-        int8_t ret_offset = (int8_t)pop8();
+        int8_t ret_offset;
+        if (ras_top && ras[ras_top - 1].sp == SP && ras[ras_top - 1].kind == RAS_RET8)
+        {
+            ret_offset = (int8_t)ras[--ras_top].value;
+            SP++;
+        }
+        else
+        {
+            ras_top = 0;
+            ret_offset = (int8_t)pop8();
+        }
         PC = uint16_t(PC + ret_offset);
     }
     break;
@@ -532,42 +841,13 @@ void CPU::step()
     }
     break;
 
-    case 0x28: // ADDF
-    {
-        uint16_t tmp = (uint16_t)A + (uint16_t)X;
-        uint8_t result = (uint8_t)tmp;
-
-        // Set flags based on result
-        P &= ~(N | Z | C | V);
-        if (result == 0)
-            P |= Z;
-        if (result & 0x80)
-            P |= N;
-        if (tmp > 0xFF)
-            P |= C;
-        // Overflow: sign of A == sign of X, but sign of result != sign of A
-        if (((A ^ result) & (X ^ result) & 0x80) != 0)
-            P |= V;
-    }
-    break;
-
-    case 0x29: // SUBF
-    {
-        uint16_t tmp = (uint16_t)A - (uint16_t)X;
-        uint8_t result = (uint8_t)tmp;
+    case 0x28: // ADDF: flags of A + X, A unchanged
+        add8(A, X, 0);
+        break;
 
-        P &= ~(N | Z | C | V);
-        if (result == 0)
-            P |= Z;
-        if (result & 0x80)
-            P |= N;
-        if (A >= X)
-            P |= C; // carry = no borrow
-        // Overflow: sign of A != sign of X, and sign of result != sign of A
-        if (((A ^ X) & (A ^ result) & 0x80) != 0)
-            P |= V;
-    }
-    break;
+    case 0x29: // SUBF: flags of A - X, A unchanged
+        sub8(A, X, 1);
+        break;
 
     case 0x2A: // BNC abs16
     {
@@ -621,21 +901,9 @@ void CPU::step()
         setNZ(X);
         break;
 
-    case 0x32: // NEG
-    {
-        uint8_t oldA = A;
-        A = (~A) + 1;
-        P &= ~(N | Z | C | V);
-        if (A == 0)
-            P |= Z;
-        if (A & 0x80)
-            P |= N;
-        if (A != 0)
-            P |= C; // carry set if not zero after negate
-        if (((oldA ^ A) & 0x80) != 0)
-            P |= V;
-    }
-    break;
+    case 0x32: // NEG (C set if the result is non-zero, V if the sign changed)
+        A = alu_out(alu::TABLES.neg[A], alu::NZCV);
+        break;
 
     case 0x33: // SWAP
     {
@@ -645,31 +913,12 @@ void CPU::step()
     }
     break;
 
-    case 0x34:
-    { // ADC #imm
-        uint8_t val = read(PC++);
-        uint16_t sum = uint16_t(A) + val + (P & C ? 1 : 0);
-        setFlag(C, sum > 0xFF);
-        uint8_t result = sum & 0xFF;
-        setFlag(Z, result == 0);
-        setFlag(N, result & 0x80);
-        // Overflow: if sign of A == sign of val, but sign of result != sign of A
-        setFlag(V, (~(A ^ val) & (A ^ result) & 0x80) != 0);
-        A = result;
+    case 0x34: // ADC #imm
+        A = add8(A, read(PC++), P & C);
         break;
-    }
-    case 0x35:
-    { // SBC #imm
-        uint8_t val = read(PC++);
-        uint16_t diff = uint16_t(A) - val - ((P & C) ? 0 : 1);
-        setFlag(C, diff < 0x100); // C=1 if no borrow
-        uint8_t result = diff & 0xFF;
-        setFlag(Z, result == 0);
-        setFlag(N, result & 0x80);
-        setFlag(V, ((A ^ val) & (A ^ result) & 0x80) != 0);
-        A = result;
+    case 0x35: // SBC #imm (C=1 if no borrow)
+        A = sub8(A, read(PC++), P & C);
         break;
-    }
 
     case 0x36:
     { // SETBRK abs16
@@ -685,48 +934,20 @@ void CPU::step()
     }
 
     case 0x38: // ROL A
-    {
-        uint8_t oldCarry = (P & C) ? 1 : 0;
-        uint8_t newCarry = (A & 0x80) ? 1 : 0;
-        A = (A << 1) | oldCarry;
-        setFlag(C, newCarry);
-        setFlag(Z, A == 0);
-        setFlag(N, A & 0x80);
+        A = alu_out(alu::TABLES.rol[P & C][A], alu::NZC);
         break;
-    }
 
     case 0x39: // ROR A
-    {
-        uint8_t oldCarry = (P & C) ? 1 : 0;
-        uint8_t newCarry = (A & 0x01) ? 1 : 0;
-        A = (A >> 1) | (oldCarry << 7);
-        setFlag(C, newCarry);
-        setFlag(Z, A == 0);
-        setFlag(N, A & 0x80);
+        A = alu_out(alu::TABLES.ror[P & C][A], alu::NZC);
         break;
-    }
 
     case 0x3A: // ASL A
-    {
-        uint8_t newCarry = (A & 0x80) ? 1 : 0;
-        A <<= 1;
-        setFlag(C, newCarry);
-        setFlag(Z, A == 0);
-        setFlag(N, A & 0x80);
+        A = alu_out(alu::TABLES.shl[A], alu::NZC);
         break;
-    }
 
     case 0x3B: // ASR A (Arithmetic Shift Right)
-    {
-        uint8_t newCarry = (A & 0x01) ? 1 : 0;
-        // Preserve sign bit for arithmetic shift
-        uint8_t sign = A & 0x80;
-        A = (A >> 1) | sign;
-        setFlag(C, newCarry);
-        setFlag(Z, A == 0);
-        setFlag(N, A & 0x80);
+        A = alu_out(alu::TABLES.asr[A], alu::NZC);
         break;
-    }
 
     case 0x3C: // BVS abs
     {
@@ -777,8 +998,7 @@ void CPU::step()
 
         // Step 3: Push return address (PC - 1, like JSR)
         uint16_t returnAddr = PC;        // PC already points after operand
-        push8((returnAddr >> 8) & 0xFF); // high byte
-        push8(returnAddr & 0xFF);        // low byte
+        call_push16(returnAddr); // high byte, then low byte
 
         // Step 4: Jump to target
         PC = targetAddr;
@@ -806,112 +1026,21 @@ void CPU::step()
         break;
     }
 
-    case 0x44: // DECOD (Bin -> BCD)
-    {
-        uint8_t value = this->A;
-        uint8_t bcd = 0;
-        bool overflow = false;
-
-        if (value > 99)
-        {
-            overflow = true; // can't represent >99 in 2-digit BCD
-            value = 99;      // clamp to max BCD
-        }
-
-        // Fast conversion without modulo
-        uint8_t tens = 0;
-        while (value >= 10)
-        {
-            value -= 10;
-            ++tens;
-        }
-
-        bcd = (tens << 4) | value;
-        this->A = bcd;
-
-        // Flag updates
-        setFlag(Z, (bcd == 0)); // Zero flag
-        setFlag(C, overflow);   // Carry flag signals overflow from binary to BCD
-
+    case 0x44: // DECOD (Bin -> BCD), values over 99 clamp to $99 and set C
+        A = alu_out(bcd::TO_BCD.e[A], Z | C);
         break;
-    }
 
     case 0x45: // DECBIN (BCD -> Bin)
-    {
-        uint8_t bcd = this->A;
-        uint8_t tens = (bcd >> 4) & 0x0F;
-        uint8_t ones = bcd & 0x0F;
-
-        uint8_t binary = tens * 10 + ones;
-        this->A = binary;
-
-        // Flag updates
-        setFlag(Z, (binary == 0)); // Zero flag
-
+        A = alu_out(bcd::TO_BIN.e[A], Z);
         break;
-    }
-
-    case 0x46: // ADDBCD
-    {
-        uint8_t a = this->A;
-        uint8_t b = this->X; // Assume second operand is in X
-        uint8_t low = (a & 0x0F) + (b & 0x0F);
-        uint8_t high = (a >> 4) + (b >> 4);
-        bool carry = false;
-
-        if (low > 9)
-        {
-            low = 0; // needed so that less subraction done.
-            high += 1;
-        }
-
-        if (high > 9)
-        {
-            high = 9; // Clamp to max BCD
-            carry = true;
-        }
-
-        this->A = (high << 4) | (low & 0x0F);
-
-        // Flag updates
-        setFlag(Z, (this->A == 0));
-        setFlag(C, carry);
-        setFlag(N, (this->A & 0x80) != 0);
-        setFlag(V, carry); // Treat overflow as V flag
 
+    case 0x46: // ADDBCD: A = A + X, clamps at 99 with C and V set
+        A = alu_out(bcd::ADD.e[A << 8 | X], Z | C | N | V);
         break;
-    }
-
-    case 0x47: // SUBBCD
-    {
-        uint8_t a = this->A;
-        uint8_t b = this->X;
-        int8_t low = (a & 0x0F) - (b & 0x0F);
-        int8_t high = (a >> 4) - (b >> 4);
-        bool borrow = false;
-
-        if (low < 0)
-        {
-            low = 0;
-            high -= 1;
-        }
-
-        if (high < 0)
-        {
-            high = 0; // Clamp to zero
-            borrow = true;
-        }
-
-        this->A = ((high & 0x0F) << 4) | (low & 0x0F);
-
-        // Flag updates
-        setFlag(Z, (this->A == 0));
-        setFlag(C, !borrow); // Carry clear means borrow occurred
-        setFlag(N, (this->A & 0x80) != 0);
-        setFlag(V, borrow); // Treat borrow as overflow
 
+    case 0x47: // SUBBCD: A = A - X, clamps at 0 with C clear and V set
+        A = alu_out(bcd::SUB.e[A << 8 | X], Z | C | N | V);
         break;
-    }
 
     case 0x48: // LDAD
     {
@@ -982,17 +1111,9 @@ void CPU::step()
         break;
     }
 
-    case 0x4C: // TST
-    {
-        uint8_t result = this->A - this->X;
-
-        setFlag(Z, result == 0);                                       // Zero if equal
-        setFlag(C, this->A >= this->X);                                // Carry if A ≥ X
-        setFlag(N, result & 0x80);                                     // Negative if result is negative
-        setFlag(V, ((this->A ^ this->X) & (this->A ^ result)) & 0x80); // Overflow detection
-
+    case 0x4C: // TST: flags of A - X (C if A >= X)
+        sub8(A, X, 1);
         break;
-    }
 
     case 0x4D: // NIBSWAP
     {
@@ -1055,17 +1176,287 @@ void CPU::step()
         break;
     }
 
+    case 0x51: // BMOV: block move, descriptor at abs16 = src(2) dst(2) len(2)
+    {
+        uint16_t desc = read16();
+        uint16_t src = read(desc) | (read(desc + 1) << 8);
+        uint16_t dst = read(desc + 2) | (read(desc + 3) << 8);
+        uint16_t len = read(desc + 4) | (read(desc + 5) << 8);
+        block_copy(dst, src, len);
+        cycles += len; // one cycle per byte on top of the base cost
+        break;
+    }
+
+    case 0x52: // BFILL: fill with A, descriptor at abs16 = dst(2) len(2)
+    {
+        uint16_t desc = read16();
+        uint16_t dst = read(desc) | (read(desc + 1) << 8);
+        uint16_t len = read(desc + 2) | (read(desc + 3) << 8);
+        block_fill(dst, A, len);
+        cycles += len;
+        break;
+    }
+
+    case 0x53: // MUL: A:X = A * X (A low, X high)
+    {
+        uint16_t res = uint16_t(A) * uint16_t(X);
+        A = res & 0xFF;
+        X = res >> 8;
+        setFlag(Z, res == 0);
+        setFlag(N, res & 0x8000);
+        setFlag(C, res > 0xFF); // high byte in use
+        break;
+    }
+
+    case 0x54: // DIV abs16: A:X = A:X / mem[abs16]
+    case 0x55: // MOD abs16: A:X = A:X % mem[abs16]
+    {
+        uint8_t divisor = read(read16());
+        uint16_t ax = (uint16_t(X) << 8) | A;
+        if (divisor == 0)
+        {
+            setFlag(V, true); // divide by zero, A:X unchanged
+            break;
+        }
+        uint16_t res = (op == 0x54) ? ax / divisor : ax % divisor;
+        A = res & 0xFF;
+        X = res >> 8;
+        setFlag(Z, res == 0);
+        setFlag(N, res & 0x8000);
+        setFlag(V, false);
+        break;
+    }
+
+    case 0x56: // ADD16 abs16: A:X += word at abs16
+    {
+        uint16_t addr = read16();
+        uint16_t a = (uint16_t(X) << 8) | A;
+        uint16_t b = read(addr) | (read(addr + 1) << 8);
+        uint32_t sum = uint32_t(a) + b;
+        uint16_t res = uint16_t(sum);
+        A = res & 0xFF;
+        X = res >> 8;
+        setFlag(Z, res == 0);
+        setFlag(N, res & 0x8000);
+        setFlag(C, sum > 0xFFFF);
+        setFlag(V, (~(a ^ b) & (a ^ res)) & 0x8000);
+        break;
+    }
+
+    case 0x57: // SUB16 abs16: A:X -= word at abs16
+    {
+        uint16_t addr = read16();
+        uint16_t a = (uint16_t(X) << 8) | A;
+        uint16_t b = read(addr) | (read(addr + 1) << 8);
+        uint16_t res = a - b;
+        A = res & 0xFF;
+        X = res >> 8;
+        setFlag(Z, res == 0);
+        setFlag(N, res & 0x8000);
+        setFlag(C, a >= b); // carry = no borrow
+        setFlag(V, ((a ^ b) & (a ^ res)) & 0x8000);
+        break;
+    }
+
+    case 0x58: // DADD: BCD string add, descriptor at abs16 = dst(2) src(2) len(2)
+    case 0x59: // DSUB: BCD string subtract, same descriptor
+    {
+        uint16_t desc = read16();
+        uint16_t dst = read(desc) | (read(desc + 1) << 8);
+        uint16_t src = read(desc + 2) | (read(desc + 3) << 8);
+        uint16_t len = read(desc + 4) | (read(desc + 5) << 8);
+        bcd_block(dst, src, len, op == 0x59);
+        cycles += len;
+        break;
+    }
+
+    case 0x5A: // TAS abs16: atomically set bit 7 of mem[abs16], N/Z from the old value
+    {
+        uint16_t addr = read16();
+        uint8_t old;
+        if (uint8_t *p = atomic_ptr(addr))
+            old = atomic_byte(p).fetch_or(0x80);
+        else
+        {
+            old = read(addr);
+            write(addr, old | 0x80);
+        }
+        setNZ(old);
+        break;
+    }
+
+    case 0x5B: // CAS abs16: if mem[abs16] == A, store X and set Z; else A = mem[abs16], clear Z
+    {
+        uint16_t addr = read16();
+        uint8_t expected = A;
+        bool swapped;
+        if (uint8_t *p = atomic_ptr(addr))
+            swapped = atomic_byte(p).compare_exchange_strong(expected, X);
+        else
+        {
+            expected = read(addr);
+            swapped = expected == A;
+            if (swapped)
+                write(addr, X);
+        }
+        A = expected;
+        setFlag(Z, swapped);
+        break;
+    }
+
+    case 0x5C: // FENCE: order all earlier memory accesses before later ones
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        break;
+
     case 0xFF:
         _halted = true;
+        stop = STOP_HALT;
         P |= H; // set Halt flag
-        printf("[HALT] Invalid opcode 0x%02X at address 0x%04X\n", op, PC);
+        if (!quiet)
+        {
+            flush_console(*this);
+            printf("[HALT] Invalid opcode 0x%02X at address 0x%04X\n", op, PC);
+        }
         break;
     default:
-        // NOP for unknown opcodes
+        // NOP for unknown opcodes, unless they are trapped (--core)
+        if (trap_unknown)
+            unknown_opcode(op);
         break;
     }
-    // Add base cycles from the table
-    cycles += CYCLES[op];
+    // Add base cycles from the table, adjusted by the timing model
+    cycles += Timing<Model>::cost(*this, op, CYCLES[op]);
+
+    if (cov_map && IS_CONTROL[op])
+        cover_edge();
+}
+
+// AFL-style edge hit: the block is identified by the PC control landed on.
+void CPU::cover_edge()
+{
+    uint16_t cur = uint16_t((PC * 0x9E3779B1u) >> 18);
+    cov_map[(cur ^ cov_prev) & (COV_MAP_SIZE - 1)]++;
+    cov_prev = cur >> 1;
+}
+
+// Fused pairs (superop.h). The second opcode is read from memory here, and
+// read again after the first instruction has run in case that instruction
+// rewrote it. A pair is not taken when the second instruction sits on a
+// flagged page, where it could be a breakpoint, a device register or banked
+// code. Each case leaves out flag writes the second instruction overwrites.
+bool CPU::run_fused(uint8_t op)
+{
+    uint16_t next = uint16_t(PC + FUSE_FIRST[op] - 1); // address of the second opcode
+    if (page_read[next >> 8] || timing_model != TIMING_FIXED || cov_map)
+        return false;
+
+    uint8_t second = mem[next];
+    switch (op << 8 | second)
+    {
+    case FUSE_LDA_STA:
+        A = read(read16());
+        setNZ(A);
+        if (fuse_continue(op, second))
+            write(read16(), A);
+        return true;
+    case FUSE_LDA_LDX:
+        A = read(read16());
+        if (!fuse_continue(op, second))
+        {
+            setNZ(A);
+            return true;
+        }
+        X = read(read16());
+        setNZ(X);
+        return true;
+    case FUSE_LDA_DEC:
+        A = read(read16());
+        if (fuse_continue(op, second))
+            A--;
+        setNZ(A);
+        return true;
+    case FUSE_STA_LDA:
+        write(read16(), A);
+        if (fuse_continue(op, second))
+        {
+            A = read(read16());
+            setNZ(A);
+        }
+        return true;
+    case FUSE_STA_BNZ:
+    {
+        write(read16(), A);
+        if (!fuse_continue(op, second))
+            return true;
+        uint16_t target = read16();
+        if (!(P & Z))
+            PC = target;
+        cycles++;
+    }
+        return true;
+    case FUSE_LDI_STA:
+        A = uint8_t(read16());
+        if (fuse_continue(op, second))
+            write(read16(), A);
+        return true;
+    case FUSE_DEC_BNZ:
+    {
+        A--;
+        setNZ(A);
+        if (!fuse_continue(op, second))
+            return true;
+        uint16_t target = read16();
+        if (A)
+            PC = target;
+        cycles++;
+    }
+        return true;
+    case FUSE_SUBF_BZ:
+    {
+        sub8(A, X, 1);
+        if (!fuse_continue(op, second))
+            return true;
+        uint16_t target = read16();
+        if (P & Z)
+            PC = target;
+        cycles++;
+    }
+        return true;
+    case FUSE_PHA_PHX:
+        push8(A);
+        if (fuse_continue(op, second))
+            push8(X);
+        return true;
+    case FUSE_PLX_PLA:
+        X = pop8();
+        if (!fuse_continue(op, second))
+        {
+            setNZ(X);
+            return true;
+        }
+        A = pop8();
+        setNZ(A);
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Between the halves of a fused pair: charges the first instruction and,
+// if the second should still run now, charges it too and moves PC past its
+// opcode. It should not when the first instruction stopped the core,
+// rewrote or remapped the second opcode, or left a device event due before
+// the second would have started; the next dispatch then runs it as usual.
+inline bool CPU::fuse_continue(uint8_t first, uint8_t second)
+{
+    cycles += CYCLES[first];
+    if (_halted || page_read[PC >> 8] || mem[PC] != second || clock + cycles + 1 >= next_event)
+        return false;
+    cycles += CYCLES[second] + 1; // and the step that would have dispatched it
+    op_pc = PC++;
+    instret++;
+    pc_history[instret % PC_HISTORY] = op_pc;
+    return true;
 }
 
 inline void CPU::setFlag(int flag, bool cond)
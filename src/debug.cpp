@@ -0,0 +1,86 @@
+#include "cpu.h"
+
+static inline bool test_bit(const uint64_t *bits, uint16_t addr)
+{
+    return (bits[addr >> 6] >> (addr & 63)) & 1;
+}
+
+static inline void set_bit(uint64_t *bits, uint16_t addr, bool on)
+{
+    if (on)
+        bits[addr >> 6] |= uint64_t(1) << (addr & 63);
+    else
+        bits[addr >> 6] &= ~(uint64_t(1) << (addr & 63));
+}
+
+// True if any address in `page` has its bit set (4 words per page).
+static inline bool page_has_bits(const uint64_t *bits, uint16_t page)
+{
+    const uint64_t *w = bits + page * 4;
+    return (w[0] | w[1] | w[2] | w[3]) != 0;
+}
+
+void CPU::set_breakpoint(uint16_t addr, bool on)
+{
+    set_bit(bp_bits, addr, on);
+    uint16_t page = addr >> 8;
+    if (page_has_bits(bp_bits, page))
+        page_read[page] |= PAGE_BREAK;
+    else
+        page_read[page] &= ~PAGE_BREAK;
+}
+
+void CPU::set_watchpoint(uint16_t addr, bool on_read, bool on_write)
+{
+    set_bit(watch_read_bits, addr, on_read);
+    set_bit(watch_write_bits, addr, on_write);
+    uint16_t page = addr >> 8;
+    if (page_has_bits(watch_read_bits, page))
+        page_read[page] |= PAGE_WATCH;
+    else
+        page_read[page] &= ~PAGE_WATCH;
+    if (page_has_bits(watch_write_bits, page))
+        page_write[page] |= PAGE_WATCH;
+    else
+        page_write[page] &= ~PAGE_WATCH;
+}
+
+// Called from step() before fetching from a flagged page. Stops the core
+// without executing anything when PC has a breakpoint.
+bool CPU::hit_breakpoint()
+{
+    if (!(page_read[PC >> 8] & PAGE_BREAK) || !test_bit(bp_bits, PC))
+        return false;
+    if (bp_resume_pc == PC)
+    {
+        bp_resume_pc = -1; // stepping off the breakpoint we stopped on
+        return false;
+    }
+    stop = STOP_BREAKPOINT;
+    _halted = true;
+    return true;
+}
+
+// Called from read_slow()/write_slow() on watched pages. The access and the
+// rest of the instruction complete; the core stops before the next one.
+void CPU::check_watch(uint16_t addr, bool is_write)
+{
+    if (!test_bit(is_write ? watch_write_bits : watch_read_bits, addr))
+        return;
+    watch_addr = addr;
+    watch_was_write = is_write;
+    stop = STOP_WATCHPOINT;
+    _halted = true;
+}
+
+// Continue after a breakpoint or watchpoint stop. HALT and faults stay
+// stopped until reset().
+void CPU::resume()
+{
+    if (stop != STOP_BREAKPOINT && stop != STOP_WATCHPOINT)
+        return;
+    if (stop == STOP_BREAKPOINT)
+        bp_resume_pc = PC;
+    stop = STOP_NONE;
+    _halted = false;
+}
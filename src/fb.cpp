@@ -0,0 +1,103 @@
+#include "cpu.h"
+#include <cstring>
+#include <stdexcept>
+
+// Turns the framebuffer on: frames go to `sink` every `interval` cycles.
+// Must be called after reset; the sink must outlive the CPU.
+void CPU::attach_framebuffer(FrameSink *sink, uint32_t interval)
+{
+    if (interval == 0)
+        throw std::runtime_error("Frame interval must be at least one cycle");
+    fb.sink = sink;
+    fb.interval = interval;
+    fb.next_frame = clock + interval;
+    for (int i = 0; i < 256; i++)
+    {
+        fb.palette[i][0] = uint8_t(((i >> 5) & 7) * 255 / 7);
+        fb.palette[i][1] = uint8_t(((i >> 2) & 7) * 255 / 7);
+        fb.palette[i][2] = uint8_t((i & 3) * 255 / 3);
+    }
+    fb.dirty = ~uint64_t(0) >> (64 - FB_PAGES); // first frame encodes everything
+    for (uint32_t page = 0; page < FB_PAGES; page++)
+        page_write[(FB_BASE >> 8) + page] &= ~PAGE_FRAME;
+    schedule_events();
+}
+
+// First write to a framebuffer page since the last frame.
+void CPU::fb_mark(uint16_t addr)
+{
+    page_write[addr >> 8] &= ~PAGE_FRAME;
+    fb.dirty |= uint64_t(1) << ((addr - FB_BASE) >> 8);
+}
+
+void CPU::fb_palette_write(uint8_t val)
+{
+    fb.palette[fb.pal_index][fb.pal_component] = val;
+    if (++fb.pal_component == 3)
+    {
+        fb.pal_component = 0;
+        fb.pal_index++;
+    }
+    fb.dirty = ~uint64_t(0) >> (64 - FB_PAGES); // every pixel may have changed
+}
+
+// Frame boundary, from run_events(). Encodes the dirty rows, hands the
+// frame to the sink and re-arms PAGE_FRAME on the pages that were written.
+void CPU::fb_frame()
+{
+    bool changed = fb.dirty != 0;
+    for (uint32_t page = 0; page < FB_PAGES; page++)
+    {
+        if (!(fb.dirty >> page & 1))
+            continue;
+        for (uint32_t row = page * 256 / FB_WIDTH; row < (page + 1) * 256 / FB_WIDTH; row++)
+        {
+            const uint8_t *src = host_ptr(uint16_t(FB_BASE + row * FB_WIDTH));
+            uint8_t *dst = fb.rgb + row * FB_WIDTH * 3;
+            for (uint32_t x = 0; x < FB_WIDTH; x++)
+                memcpy(dst + x * 3, fb.palette[src[x]], 3);
+        }
+        page_write[(FB_BASE >> 8) + page] |= PAGE_FRAME;
+    }
+    fb.dirty = 0;
+    fb.sink->write(fb.frame, fb.rgb, changed);
+    fb.frame++;
+    fb.next_frame += fb.interval;
+}
+
+FrameSink::FrameSink(Kind kind, const char *path) : kind(kind), path(path)
+{
+    if (kind == SINK_RAW)
+    {
+        raw = std::fopen(path, "wb");
+        if (!raw)
+            throw std::runtime_error(std::string("Cannot open ") + path);
+    }
+}
+
+FrameSink::~FrameSink()
+{
+    if (raw)
+        std::fclose(raw);
+}
+
+void FrameSink::write(uint32_t frame, const uint8_t *rgb, bool changed)
+{
+    if (kind == SINK_RAW)
+    {
+        std::fwrite(rgb, 1, FB_SIZE * 3, raw);
+        written++;
+        return;
+    }
+    if (!changed)
+        return;
+    char name[32];
+    std::snprintf(name, sizeof(name), "/frame_%06u.ppm", frame);
+    FILE *f = std::fopen((path + name).c_str(), "wb");
+    if (!f)
+        throw std::runtime_error("Cannot write " + path + name);
+    std::fprintf(f, "P6\n%u %u\n255\n", FB_WIDTH, FB_HEIGHT);
+    std::fwrite(rgb, 1, FB_SIZE * 3, f);
+    std::fclose(f);
+    written++;
+}
@@ -0,0 +1,450 @@
+#include "fuzz.h"
+#include "cpu.h"
+#include "run.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// Hit counts are bucketed so a loop running 5 or 6 times counts as the same
+// behavior but 1, 2, 3, 4-7, 8-15, ... iterations are all distinct.
+static uint8_t COUNT_CLASS[256];
+
+static void init_count_class()
+{
+    for (int i = 0; i < 256; i++)
+    {
+        uint8_t c = 0;
+        if (i == 1) c = 1;
+        else if (i == 2) c = 2;
+        else if (i == 3) c = 4;
+        else if (i >= 4 && i <= 7) c = 8;
+        else if (i >= 8 && i <= 15) c = 16;
+        else if (i >= 16 && i <= 31) c = 32;
+        else if (i >= 32 && i <= 127) c = 64;
+        else if (i >= 128) c = 128;
+        COUNT_CLASS[i] = c;
+    }
+}
+
+static const uint8_t INTERESTING8[] = {0x00, 0x01, 0x10, 0x20, 0x40, 0x7F, 0x80, 0x81, 0xFE, 0xFF};
+static const uint16_t INTERESTING16[] = {0x0000, 0x0080, 0x00FF, 0x0100, 0x7FFF, 0x8000, 0xFF7F, 0xFFFF};
+
+// Registers and device state at the injection point. Memory is restored
+// separately, one dirty page at a time.
+struct CoreState
+{
+    uint8_t A, X, SP, P;
+    uint16_t PC, op_pc, break_addr;
+    uint32_t cycles;
+    bool halted;
+    uint64_t clock, next_event;
+    Dma dma;
+    BlockDev blk;
+    uint8_t fault, stop;
+    uint16_t fault_pc;
+    int32_t bp_resume_pc;
+    CPU::RasEntry ras[CPU::RAS_SIZE];
+    uint8_t ras_top;
+};
+
+static void save_core(const CPU &cpu, CoreState &s)
+{
+    s.A = cpu.A;
+    s.X = cpu.X;
+    s.SP = cpu.SP;
+    s.P = cpu.P;
+    s.PC = cpu.PC;
+    s.op_pc = cpu.op_pc;
+    s.break_addr = cpu.break_addr;
+    s.cycles = cpu.cycles;
+    s.halted = cpu._halted;
+    s.clock = cpu.clock;
+    s.next_event = cpu.next_event;
+    s.dma = cpu.dma;
+    s.blk = cpu.blk;
+    s.fault = cpu.fault;
+    s.stop = cpu.stop;
+    s.fault_pc = cpu.fault_pc;
+    s.bp_resume_pc = cpu.bp_resume_pc;
+    std::memcpy(s.ras, cpu.ras, sizeof(s.ras));
+    s.ras_top = cpu.ras_top;
+}
+
+static void load_core(CPU &cpu, const CoreState &s)
+{
+    cpu.A = s.A;
+    cpu.X = s.X;
+    cpu.SP = s.SP;
+    cpu.P = s.P;
+    cpu.PC = s.PC;
+    cpu.op_pc = s.op_pc;
+    cpu.break_addr = s.break_addr;
+    cpu.cycles = s.cycles;
+    cpu._halted = s.halted;
+    cpu.clock = s.clock;
+    cpu.next_event = s.next_event;
+    cpu.dma = s.dma;
+    cpu.blk = s.blk;
+    cpu.fault = s.fault;
+    cpu.stop = s.stop;
+    cpu.fault_pc = s.fault_pc;
+    cpu.bp_resume_pc = s.bp_resume_pc;
+    std::memcpy(cpu.ras, s.ras, sizeof(s.ras));
+    cpu.ras_top = s.ras_top;
+}
+
+static void write_file(const fs::path &path, const std::vector<uint8_t> &data)
+{
+    std::ofstream f(path, std::ios::binary);
+    if (!f)
+        throw std::runtime_error("Cannot write " + path.string());
+    f.write(reinterpret_cast<const char *>(data.data()), std::streamsize(data.size()));
+}
+
+namespace
+{
+
+class Fuzzer
+{
+public:
+    Fuzzer(CPU &cpu, const FuzzConfig &cfg) : cpu(cpu), cfg(cfg) {}
+    void run();
+
+private:
+    enum Result
+    {
+        EXEC_OK,
+        EXEC_CRASH,
+        EXEC_HANG
+    };
+
+    CPU &cpu;
+    const FuzzConfig &cfg;
+    std::vector<uint8_t> snap_mem;
+    CoreState snap{};
+    uint8_t trace[CPU::COV_MAP_SIZE];
+    uint8_t virgin[CPU::COV_MAP_SIZE]{};
+    uint8_t virgin_hang[CPU::COV_MAP_SIZE]{};
+    std::vector<std::vector<uint8_t>> queue;
+    std::set<uint32_t> crash_sites;
+    uint64_t rng_state = 0;
+    uint64_t execs = 0;
+    uint32_t edges = 0;
+    uint32_t crashes = 0;
+    uint32_t hangs = 0;
+
+    uint32_t rnd(uint32_t n)
+    {
+        rng_state ^= rng_state << 13;
+        rng_state ^= rng_state >> 7;
+        rng_state ^= rng_state << 17;
+        return uint32_t(rng_state % n);
+    }
+
+    void snapshot();
+    void restore();
+    Result exec(const std::vector<uint8_t> &input);
+    int has_new_bits(uint8_t *virgin_map, bool count_edges);
+    void mutate(std::vector<uint8_t> &buf);
+    void load_corpus();
+    void report(double secs);
+};
+
+// Runs from reset to the injection point and records that state. From here
+// on every page starts out tracked, so restore() only copies what an exec
+// actually wrote.
+void Fuzzer::snapshot()
+{
+    if (cpu.mmu.windows)
+        throw std::runtime_error("Fuzzing does not support bank switching");
+    if (cfg.start_pc >= 0 && cpu.PC != cfg.start_pc)
+    {
+        cpu.set_breakpoint(uint16_t(cfg.start_pc), true);
+        cpu.run_until(CycleBudget(cfg.max_cycles * 100));
+        cpu.set_breakpoint(uint16_t(cfg.start_pc), false);
+        if (cpu.stop != CPU::STOP_BREAKPOINT)
+            throw std::runtime_error("Program never reached the fuzzing start address");
+        cpu.stop = CPU::STOP_NONE;
+        cpu._halted = false;
+    }
+    snap_mem.assign(cpu.mem, cpu.mem + 65536);
+    save_core(cpu, snap);
+    for (int page = 0; page < 256; page++)
+        cpu.page_write[page] |= CPU::PAGE_TRACK;
+    cpu.dirty_count = 0;
+}
+
+void Fuzzer::restore()
+{
+    for (uint16_t i = 0; i < cpu.dirty_count; i++)
+    {
+        uint8_t page = cpu.dirty_pages[i];
+        std::memcpy(cpu.mem + page * 256, snap_mem.data() + page * 256, 256);
+        cpu.page_write[page] |= CPU::PAGE_TRACK;
+    }
+    cpu.dirty_count = 0;
+    // Pushes and pops bypass write(), so the stack page is always copied.
+    std::memcpy(cpu.stack_page(), snap_mem.data() + STACK_BASE, 256);
+    load_core(cpu, snap);
+}
+
+Fuzzer::Result Fuzzer::exec(const std::vector<uint8_t> &input)
+{
+    restore();
+    size_t n = std::min<size_t>(input.size(), cfg.input_max);
+    for (size_t i = 0; i < n; i++)
+        cpu.write(uint16_t(cfg.input_addr + i), input[i]);
+    if (cfg.len_addr >= 0)
+    {
+        cpu.write(uint16_t(cfg.len_addr), uint8_t(n));
+        cpu.write(uint16_t(cfg.len_addr + 1), uint8_t(n >> 8));
+    }
+
+    std::memset(trace, 0, sizeof(trace));
+    cpu.cov_prev = 0;
+    cpu.run_until(CycleBudget(cfg.max_cycles));
+    execs++;
+
+    if (cpu.stop == CPU::STOP_FAULT)
+        return EXEC_CRASH;
+    return cpu._halted ? EXEC_OK : EXEC_HANG;
+}
+
+// Merges the bucketed trace into `virgin_map`. Returns 2 for a new edge,
+// 1 for a new hit count on a known edge, 0 for nothing new.
+int Fuzzer::has_new_bits(uint8_t *virgin_map, bool count_edges)
+{
+    int ret = 0;
+    const uint64_t *words = reinterpret_cast<const uint64_t *>(trace);
+    for (uint32_t w = 0; w < CPU::COV_MAP_SIZE / 8; w++)
+    {
+        if (!words[w])
+            continue;
+        for (uint32_t i = w * 8; i < w * 8 + 8; i++)
+        {
+            uint8_t c = COUNT_CLASS[trace[i]];
+            if (!(c & ~virgin_map[i]))
+                continue;
+            if (!virgin_map[i])
+            {
+                ret = 2;
+                if (count_edges)
+                    edges++;
+            }
+            else if (!ret)
+                ret = 1;
+            virgin_map[i] |= c;
+        }
+    }
+    return ret;
+}
+
+// Stacked havoc mutations, as in AFL.
+void Fuzzer::mutate(std::vector<uint8_t> &buf)
+{
+    int count = 1 << (1 + rnd(4));
+    for (int m = 0; m < count; m++)
+    {
+        size_t len = buf.size();
+        switch (rnd(9))
+        {
+        case 0: // flip a bit
+            buf[rnd(uint32_t(len))] ^= uint8_t(1 << rnd(8));
+            break;
+        case 1: // interesting byte
+            buf[rnd(uint32_t(len))] = INTERESTING8[rnd(sizeof(INTERESTING8))];
+            break;
+        case 2: // random byte
+            buf[rnd(uint32_t(len))] = uint8_t(rnd(256));
+            break;
+        case 3: // small add/subtract
+        {
+            uint8_t &b = buf[rnd(uint32_t(len))];
+            uint8_t delta = uint8_t(1 + rnd(16));
+            b = rnd(2) ? uint8_t(b + delta) : uint8_t(b - delta);
+            break;
+        }
+        case 4: // interesting word, little endian like the CPU
+            if (len >= 2)
+            {
+                size_t pos = rnd(uint32_t(len - 1));
+                uint16_t v = INTERESTING16[rnd(sizeof(INTERESTING16) / 2)];
+                buf[pos] = uint8_t(v);
+                buf[pos + 1] = uint8_t(v >> 8);
+            }
+            break;
+        case 5: // delete a block
+            if (len >= 2)
+            {
+                size_t del = 1 + rnd(uint32_t(std::min<size_t>(len - 1, 16)));
+                size_t pos = rnd(uint32_t(len - del + 1));
+                buf.erase(buf.begin() + pos, buf.begin() + pos + del);
+            }
+            break;
+        case 6: // clone a block or insert a run of one byte
+            if (len < cfg.input_max)
+            {
+                size_t ins = 1 + rnd(uint32_t(std::min<size_t>(cfg.input_max - len, 16)));
+                size_t at = rnd(uint32_t(len + 1));
+                std::vector<uint8_t> block;
+                if (rnd(4) && ins <= len)
+                {
+                    size_t from = rnd(uint32_t(len - ins + 1));
+                    block.assign(buf.begin() + from, buf.begin() + from + ins);
+                }
+                else
+                    block.assign(ins, rnd(2) ? uint8_t(rnd(256)) : buf[rnd(uint32_t(len))]);
+                buf.insert(buf.begin() + at, block.begin(), block.end());
+            }
+            break;
+        case 7: // overwrite with a block from elsewhere in the input
+            if (len >= 2)
+            {
+                size_t n = 1 + rnd(uint32_t(std::min<size_t>(len - 1, 16)));
+                size_t from = rnd(uint32_t(len - n + 1));
+                size_t to = rnd(uint32_t(len - n + 1));
+                std::memmove(buf.data() + to, buf.data() + from, n);
+            }
+            break;
+        case 8: // splice in a block from another corpus entry
+        {
+            const std::vector<uint8_t> &other = queue[rnd(uint32_t(queue.size()))];
+            size_t n = std::min(other.size(), len);
+            if (n)
+            {
+                n = 1 + rnd(uint32_t(n));
+                size_t from = rnd(uint32_t(other.size() - n + 1));
+                size_t to = rnd(uint32_t(len - n + 1));
+                std::memcpy(buf.data() + to, other.data() + from, n);
+            }
+            break;
+        }
+        }
+    }
+}
+
+void Fuzzer::load_corpus()
+{
+    fs::create_directories(fs::path(cfg.corpus_dir) / "crashes");
+    fs::create_directories(fs::path(cfg.corpus_dir) / "hangs");
+    std::vector<fs::path> files;
+    for (const fs::directory_entry &e : fs::directory_iterator(cfg.corpus_dir))
+        if (e.is_regular_file())
+            files.push_back(e.path());
+    std::sort(files.begin(), files.end());
+
+    for (const fs::path &p : files)
+    {
+        std::ifstream f(p, std::ios::binary);
+        std::vector<uint8_t> data((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+        if (data.empty())
+            continue;
+        if (data.size() > cfg.input_max)
+            data.resize(cfg.input_max);
+        if (exec(data) == EXEC_OK)
+            has_new_bits(virgin, true);
+        queue.push_back(std::move(data));
+    }
+    if (queue.empty())
+    {
+        std::vector<uint8_t> seed(1, 0);
+        exec(seed);
+        has_new_bits(virgin, true);
+        write_file(fs::path(cfg.corpus_dir) / "seed", seed);
+        queue.push_back(seed);
+    }
+}
+
+void Fuzzer::report(double secs)
+{
+    std::printf("[FUZZ] execs %llu (%.0f/s)  corpus %zu  edges %u  crashes %u  hangs %u\n",
+                (unsigned long long)execs, secs > 0 ? execs / secs : 0.0, queue.size(), edges, crashes, hangs);
+    std::fflush(stdout);
+}
+
+void Fuzzer::run()
+{
+    init_count_class();
+    rng_state = cfg.seed ? cfg.seed : uint64_t(std::chrono::steady_clock::now().time_since_epoch().count()) | 1;
+
+    snapshot();
+    cpu.cov_map = trace;
+    cpu.quiet = true;
+    load_corpus();
+
+    fs::path dir(cfg.corpus_dir);
+    auto start = std::chrono::steady_clock::now();
+    auto last_report = start;
+    size_t cur = 0;
+    char name[64];
+    std::vector<uint8_t> buf;
+    while (!cfg.max_execs || execs < cfg.max_execs)
+    {
+        buf = queue[cur];
+        cur = (cur + 1) % queue.size();
+        mutate(buf);
+
+        switch (exec(buf))
+        {
+        case EXEC_OK:
+            if (has_new_bits(virgin, true))
+            {
+                std::snprintf(name, sizeof(name), "id_%06zu", queue.size());
+                write_file(dir / name, buf);
+                queue.push_back(buf);
+            }
+            break;
+        case EXEC_CRASH:
+            // One file per faulting instruction and fault kind.
+            if (crash_sites.insert(uint32_t(cpu.fault_pc) << 8 | cpu.fault).second)
+            {
+                std::snprintf(name, sizeof(name), "fault_%04x_%u", cpu.fault_pc, cpu.fault);
+                write_file(dir / "crashes" / name, buf);
+                crashes++;
+            }
+            break;
+        case EXEC_HANG:
+            if (has_new_bits(virgin_hang, false))
+            {
+                std::snprintf(name, sizeof(name), "hang_%06u", hangs);
+                write_file(dir / "hangs" / name, buf);
+                hangs++;
+            }
+            break;
+        }
+
+        if ((execs & 0xFFF) == 0)
+        {
+            auto now = std::chrono::steady_clock::now();
+            if (now - last_report >= std::chrono::seconds(1))
+            {
+                report(std::chrono::duration<double>(now - start).count());
+                last_report = now;
+            }
+        }
+    }
+    report(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    cpu.cov_map = nullptr;
+}
+
+} // namespace
+
+void fuzz(CPU &cpu, const FuzzConfig &cfg)
+{
+    if (!cfg.corpus_dir)
+        throw std::runtime_error("No corpus directory");
+    if (cfg.input_max == 0 || uint32_t(cfg.input_addr) + cfg.input_max > 0x10000)
+        throw std::runtime_error("Bad fuzzing input region");
+    Fuzzer fuzzer(cpu, cfg);
+    fuzzer.run();
+}
@@ -0,0 +1,428 @@
+#include "gdb_stub.h"
+#include "cpu.h"
+#include "run.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef int socklen_t;
+#define close_socket closesocket
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#define close_socket ::close
+#endif
+
+static const char HEX[] = "0123456789abcdef";
+
+static int hex_digit(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+static void put_hex8(std::string &out, uint8_t v)
+{
+    out += HEX[v >> 4];
+    out += HEX[v & 15];
+}
+
+static uint8_t get_hex8(const std::string &s, size_t pos)
+{
+    if (pos + 2 > s.size())
+        return 0;
+    return uint8_t(hex_digit(s[pos]) << 4 | hex_digit(s[pos + 1]));
+}
+
+// True if s holds exactly `count` hex digits from `pos` to its end.
+static bool is_hex(const std::string &s, size_t pos, size_t count)
+{
+    if (pos > s.size() || s.size() - pos != count)
+        return false;
+    for (size_t i = pos; i < s.size(); i++)
+        if (hex_digit(s[i]) < 0)
+            return false;
+    return true;
+}
+
+// Parses "addr,len" (and optionally ",kind" or ":data" after it).
+static bool parse_addr_len(const std::string &s, size_t pos, uint32_t &addr, uint32_t &len, size_t *end = nullptr)
+{
+    char *p;
+    addr = uint32_t(std::strtoul(s.c_str() + pos, &p, 16));
+    if (*p != ',')
+        return false;
+    len = uint32_t(std::strtoul(p + 1, &p, 16));
+    if (end)
+        *end = size_t(p - s.c_str());
+    return true;
+}
+
+void GdbStub::listen(const char *spec)
+{
+    close();
+#ifdef _WIN32
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0)
+        throw std::runtime_error("WSAStartup failed");
+#endif
+    intptr_t l;
+    if (std::strncmp(spec, "unix:", 5) == 0)
+    {
+#ifdef _WIN32
+        throw std::runtime_error("Unix sockets are not supported on this platform");
+#else
+        sockaddr_un sa{};
+        sa.sun_family = AF_UNIX;
+        if (std::strlen(spec + 5) >= sizeof(sa.sun_path))
+            throw std::runtime_error(std::string("Socket path too long: ") + (spec + 5));
+        std::strcpy(sa.sun_path, spec + 5);
+        l = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (l < 0)
+            throw std::runtime_error("Cannot create socket");
+        unlink(sa.sun_path);
+        if (bind(int(l), (sockaddr *)&sa, sizeof(sa)) != 0)
+        {
+            close_socket(int(l));
+            throw std::runtime_error(std::string("Cannot bind ") + sa.sun_path);
+        }
+        unix_path = sa.sun_path;
+#endif
+    }
+    else
+    {
+        sockaddr_in sa{};
+        sa.sin_family = AF_INET;
+        sa.sin_port = htons(uint16_t(std::strtoul(spec, nullptr, 10)));
+        sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        l = intptr_t(socket(AF_INET, SOCK_STREAM, 0));
+        if (l < 0)
+            throw std::runtime_error("Cannot create socket");
+        int one = 1;
+        setsockopt(l, SOL_SOCKET, SO_REUSEADDR, (const char *)&one, sizeof(one));
+        if (bind(l, (sockaddr *)&sa, sizeof(sa)) != 0)
+        {
+            close_socket(l);
+            throw std::runtime_error(std::string("Cannot bind port ") + spec);
+        }
+    }
+    listener = l;
+    if (::listen(listener, 1) != 0)
+        throw std::runtime_error("Cannot listen");
+
+    std::printf("[GDB] Waiting for debugger on %s\n", spec);
+    std::fflush(stdout);
+    sock = intptr_t(accept(listener, nullptr, nullptr));
+    if (sock < 0)
+        throw std::runtime_error("Accept failed");
+    int one = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, (const char *)&one, sizeof(one));
+}
+
+void GdbStub::close()
+{
+    if (sock >= 0)
+        close_socket(sock);
+    if (listener >= 0)
+        close_socket(listener);
+    sock = listener = -1;
+#ifndef _WIN32
+    if (!unix_path.empty())
+        unlink(unix_path.c_str());
+#endif
+    unix_path.clear();
+}
+
+// Reads one "$data#cs" packet and acknowledges it. Returns false when the
+// connection is gone.
+bool GdbStub::get_packet(std::string &out)
+{
+    char c;
+    for (;;)
+    {
+        do
+        {
+            if (recv(sock, &c, 1, 0) != 1)
+                return false;
+        } while (c != '$'); // skips acks and stray interrupts while stopped
+
+        out.clear();
+        uint8_t sum = 0;
+        bool overflow = false; // longer than the advertised GDB_PACKET_SIZE
+        for (;;)
+        {
+            if (recv(sock, &c, 1, 0) != 1)
+                return false;
+            if (c == '#')
+                break;
+            if (out.size() == GDB_PACKET_SIZE)
+                overflow = true; // the rest is read and dropped
+            if (overflow)
+                continue;
+            out += c;
+            sum += uint8_t(c);
+        }
+        char cs[2];
+        if (recv(sock, cs, 1, 0) != 1 || recv(sock, cs + 1, 1, 0) != 1)
+            return false;
+        bool ok = !overflow && hex_digit(cs[0]) >= 0 &&
+                  uint8_t(hex_digit(cs[0]) << 4 | hex_digit(cs[1])) == sum;
+        send(sock, ok ? "+" : "-", 1, 0);
+        if (ok)
+            return true;
+    }
+}
+
+void GdbStub::put_packet(const std::string &data)
+{
+    std::string pkt = "$";
+    uint8_t sum = 0;
+    for (char c : data)
+        sum += uint8_t(c);
+    pkt += data;
+    pkt += '#';
+    put_hex8(pkt, sum);
+    for (;;)
+    {
+        send(sock, pkt.data(), int(pkt.size()), 0);
+        char ack;
+        if (recv(sock, &ack, 1, 0) != 1 || ack != '-')
+            return;
+    }
+}
+
+// Non-blocking check for the debugger's interrupt byte (Ctrl-C).
+bool GdbStub::interrupted()
+{
+#ifdef _WIN32
+    u_long avail = 0;
+    ioctlsocket(sock, FIONREAD, &avail);
+    if (!avail)
+        return false;
+#else
+    pollfd pfd{int(sock), POLLIN, 0};
+    if (poll(&pfd, 1, 0) <= 0)
+        return false;
+#endif
+    char c;
+    return recv(sock, &c, 1, 0) == 1 && c == 0x03;
+}
+
+void GdbStub::serve()
+{
+    std::string pkt;
+    bool done = false;
+    while (!done && get_packet(pkt))
+    {
+        std::string reply = handle(pkt, done);
+        if (!done || pkt[0] == 'D')
+            put_packet(reply);
+    }
+    close();
+}
+
+std::string GdbStub::stop_reply() const
+{
+    char buf[32];
+    switch (cpu.stop)
+    {
+    case CPU::STOP_HALT:
+        return "S04"; // SIGILL, HALT is the invalid opcode
+    case CPU::STOP_FAULT:
+        return cpu.fault == CPU::FAULT_UNKNOWN_OPCODE ? "S04" : "S0b"; // SIGILL, SIGSEGV
+    case CPU::STOP_WATCHPOINT:
+        std::snprintf(buf, sizeof(buf), "T05%s:%04x;", cpu.watch_was_write ? "watch" : "rwatch", cpu.watch_addr);
+        return buf;
+    default:
+        return "S05"; // SIGTRAP
+    }
+}
+
+// Single-steps one instruction or runs until the core stops. The remaining
+// penalty cycles of the last instruction are drained first so a step always
+// starts on an instruction boundary.
+std::string GdbStub::resume(bool single)
+{
+    cpu.resume();
+    while (cpu.cycles > 0)
+        cpu.step();
+    if (single)
+    {
+        cpu.run_until(InstructionBudget(1));
+        return stop_reply();
+    }
+    for (;;)
+    {
+        if (cpu.run_until(CycleBudget(GDB_POLL_CYCLES)) == RUN_HALT)
+            return stop_reply();
+        if (interrupted())
+            return "S02"; // SIGINT
+    }
+}
+
+std::string GdbStub::read_regs() const
+{
+    std::string out;
+    put_hex8(out, cpu.A);
+    put_hex8(out, cpu.X);
+    put_hex8(out, cpu.SP);
+    put_hex8(out, cpu.P);
+    put_hex8(out, cpu.PC & 0xFF);
+    put_hex8(out, cpu.PC >> 8);
+    return out;
+}
+
+void GdbStub::write_regs(const std::string &hex)
+{
+    cpu.A = get_hex8(hex, 0);
+    cpu.X = get_hex8(hex, 2);
+    cpu.SP = get_hex8(hex, 4);
+    cpu.P = get_hex8(hex, 6);
+    cpu.PC = uint16_t(get_hex8(hex, 8) | get_hex8(hex, 10) << 8);
+    cpu.ras_top = 0; // SP may no longer match the shadow stack
+}
+
+// Debugger memory accesses go straight to the backing store (banked
+// windows included) so they never trigger device side effects or
+// watchpoints.
+std::string GdbStub::read_mem(uint32_t addr, uint32_t len)
+{
+    std::string out;
+    for (uint32_t i = 0; i < len; i++)
+        put_hex8(out, *cpu.host_ptr(uint16_t(addr + i)));
+    return out;
+}
+
+void GdbStub::write_mem(uint32_t addr, uint32_t len, const std::string &hex)
+{
+    for (uint32_t i = 0; i < len; i++)
+    {
+        uint16_t a = uint16_t(addr + i);
+        *cpu.host_ptr(a) = get_hex8(hex, i * 2);
+        if ((a >> 8) == (STACK_BASE >> 8))
+            cpu.ras_top = 0;
+    }
+}
+
+std::string GdbStub::handle(const std::string &pkt, bool &done)
+{
+    if (pkt.empty())
+        return "";
+    uint32_t addr, len;
+    size_t end;
+    switch (pkt[0])
+    {
+    case '?':
+        return stop_reply();
+    case 'g':
+        return read_regs();
+    case 'G':
+        if (!is_hex(pkt, 1, 12))
+            return "E01";
+        write_regs(pkt.substr(1));
+        return "OK";
+    case 'p':
+    {
+        unsigned long n = std::strtoul(pkt.c_str() + 1, nullptr, 16);
+        std::string regs = read_regs();
+        if (n < 4)
+            return regs.substr(n * 2, 2);
+        if (n == 4)
+            return regs.substr(8, 4);
+        return "E01";
+    }
+    case 'P':
+    {
+        char *p;
+        unsigned long n = std::strtoul(pkt.c_str() + 1, &p, 16);
+        size_t digits = n < 4 ? 2 : 4; // PC is 16 bits
+        size_t val = size_t(p - pkt.c_str()) + 1;
+        if (*p != '=' || n > 4 || !is_hex(pkt, val, digits))
+            return "E01";
+        std::string regs = read_regs();
+        regs.replace(n < 4 ? n * 2 : 8, digits, pkt, val, digits);
+        write_regs(regs);
+        return "OK";
+    }
+    case 'm':
+        if (!parse_addr_len(pkt, 1, addr, len) || len > GDB_PACKET_SIZE / 2)
+            return "E01";
+        return read_mem(addr, len);
+    case 'M':
+        if (!parse_addr_len(pkt, 1, addr, len, &end) || end >= pkt.size() || pkt[end] != ':' ||
+            len > GDB_PACKET_SIZE / 2 || !is_hex(pkt, end + 1, size_t(len) * 2))
+            return "E01";
+        write_mem(addr, len, pkt.substr(end + 1));
+        return "OK";
+    case 'c':
+    case 's':
+        if (pkt.size() > 1)
+            cpu.PC = uint16_t(std::strtoul(pkt.c_str() + 1, nullptr, 16));
+        return resume(pkt[0] == 's');
+    case 'Z':
+    case 'z':
+    {
+        bool on = pkt[0] == 'Z';
+        char type = pkt.size() > 1 ? pkt[1] : 0;
+        if (pkt.size() < 3 || !parse_addr_len(pkt, 3, addr, len))
+            return "E01";
+        if (type == '0' || type == '1') // software and hardware breakpoints are the same here
+        {
+            cpu.set_breakpoint(uint16_t(addr), on);
+            return "OK";
+        }
+        if (type < '2' || type > '4')
+            return "";
+        bool rd = type == '3' || type == '4';
+        bool wr = type == '2' || type == '4';
+        for (uint32_t i = 0; i < (len ? len : 1); i++)
+        {
+            uint16_t a = uint16_t(addr + i);
+            bool cur_rd = (cpu.watch_read_bits[a >> 6] >> (a & 63)) & 1;
+            bool cur_wr = (cpu.watch_write_bits[a >> 6] >> (a & 63)) & 1;
+            cpu.set_watchpoint(a, rd ? on : cur_rd, wr ? on : cur_wr);
+        }
+        return "OK";
+    }
+    case 'H':
+        return "OK"; // single thread
+    case 'q':
+        if (pkt.compare(0, 10, "qSupported") == 0)
+        {
+            char buf[32];
+            std::snprintf(buf, sizeof(buf), "PacketSize=%x", GDB_PACKET_SIZE);
+            return buf;
+        }
+        if (pkt == "qAttached")
+            return "1";
+        if (pkt == "qC")
+            return "QC1";
+        if (pkt == "qfThreadInfo")
+            return "m1";
+        if (pkt == "qsThreadInfo")
+            return "l";
+        return "";
+    case 'D':
+        done = true;
+        return "OK";
+    case 'k':
+        done = true;
+        return "";
+    default:
+        return "";
+    }
+}
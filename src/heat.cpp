@@ -0,0 +1,147 @@
+#include "heat.h"
+#include "cpu.h"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+HeatMap::HeatMap(uint32_t window)
+    : bytes(new uint64_t[65536][KINDS]()), window(window), window_end(0),
+      byte_seen(new uint32_t[65536]())
+{
+    if (window == 0)
+        throw std::runtime_error("Heatmap window must be positive");
+}
+
+void HeatMap::record(uint16_t addr, uint8_t kind, uint64_t clock)
+{
+    if (clock >= window_end)
+        next_window(clock);
+    pages[addr >> 8][kind]++;
+    bytes[addr][kind]++;
+    if (page_seen[addr >> 8] != window_id)
+    {
+        page_seen[addr >> 8] = window_id;
+        current.pages++;
+    }
+    if (byte_seen[addr] != window_id)
+    {
+        byte_seen[addr] = window_id;
+        current.bytes++;
+    }
+}
+
+// Windows are aligned to multiples of `window` cycles; the ones the clock
+// skipped without an access (a long block transfer) are recorded empty.
+void HeatMap::next_window(uint64_t clock)
+{
+    if (window_end)
+    {
+        windows.push_back(current);
+        while (window_end + window <= clock)
+        {
+            windows.push_back({window_end, 0, 0});
+            window_end += window;
+        }
+    }
+    current = {clock - clock % window, 0, 0};
+    window_end = current.start + window;
+    window_id++;
+}
+
+void HeatMap::finish()
+{
+    if (window_end)
+        windows.push_back(current);
+    window_end = 0;
+}
+
+static const char *const KIND_NAMES = "code,data_read,data_write,stack_read,stack_write";
+
+void HeatMap::save(const char *path) const
+{
+    FILE *f = std::fopen(path, "w");
+    if (!f)
+        throw std::runtime_error(std::string("Cannot write ") + path);
+    std::fprintf(f, "# pages\npage,%s\n", KIND_NAMES);
+    for (int p = 0; p < 256; p++)
+    {
+        const uint64_t *c = pages[p];
+        if (c[CODE] | c[DATA_READ] | c[DATA_WRITE] | c[STACK_READ] | c[STACK_WRITE])
+            std::fprintf(f, "%02X,%llu,%llu,%llu,%llu,%llu\n", p, (unsigned long long)c[CODE],
+                         (unsigned long long)c[DATA_READ], (unsigned long long)c[DATA_WRITE],
+                         (unsigned long long)c[STACK_READ], (unsigned long long)c[STACK_WRITE]);
+    }
+    std::fprintf(f, "\n# addresses\naddr,%s\n", KIND_NAMES);
+    for (uint32_t a = 0; a < 65536; a++)
+    {
+        const uint64_t *c = bytes[a];
+        if (c[CODE] | c[DATA_READ] | c[DATA_WRITE] | c[STACK_READ] | c[STACK_WRITE])
+            std::fprintf(f, "%04X,%llu,%llu,%llu,%llu,%llu\n", a, (unsigned long long)c[CODE],
+                         (unsigned long long)c[DATA_READ], (unsigned long long)c[DATA_WRITE],
+                         (unsigned long long)c[STACK_READ], (unsigned long long)c[STACK_WRITE]);
+    }
+    std::fprintf(f, "\n# working set per %u cycles\nstart,pages,bytes\n", window);
+    for (const Window &w : windows)
+        std::fprintf(f, "%llu,%u,%u\n", (unsigned long long)w.start, w.pages, w.bytes);
+    bool ok = std::ferror(f) == 0;
+    if (std::fclose(f) != 0 || !ok)
+        throw std::runtime_error(std::string("Cannot write ") + path);
+}
+
+void HeatMap::summary(FILE *out) const
+{
+    int touched = 0, code = 0, data = 0, stack = 0;
+    for (int p = 0; p < 256; p++)
+    {
+        const uint64_t *c = pages[p];
+        code += c[CODE] != 0;
+        data += (c[DATA_READ] | c[DATA_WRITE]) != 0;
+        stack += (c[STACK_READ] | c[STACK_WRITE]) != 0;
+        touched += (c[CODE] | c[DATA_READ] | c[DATA_WRITE] | c[STACK_READ] | c[STACK_WRITE]) != 0;
+    }
+    std::fprintf(out, "[HEAT] %d pages touched: %d code, %d data, %d stack\n", touched, code, data, stack);
+    if (windows.empty())
+        return;
+    uint32_t peak_pages = 0, peak_bytes = 0;
+    double sum_pages = 0, sum_bytes = 0;
+    for (const Window &w : windows)
+    {
+        peak_pages = std::max(peak_pages, w.pages);
+        peak_bytes = std::max(peak_bytes, w.bytes);
+        sum_pages += w.pages;
+        sum_bytes += w.bytes;
+    }
+    std::fprintf(out, "[HEAT] working set per %u cycles: peak %u pages / %u bytes, average %.1f pages / %.0f bytes over %zu windows\n",
+                 window, peak_pages, peak_bytes, sum_pages / windows.size(), sum_bytes / windows.size(),
+                 windows.size());
+}
+
+// Routes every access through the slow paths, where read_slow(),
+// write_slow() and the stack's checked path count it.
+void CPU::attach_heatmap(HeatMap *map)
+{
+    heat = map;
+    for (int p = 0; p < 256; p++)
+    {
+        page_read[p] |= PAGE_HEAT;
+        page_write[p] |= PAGE_HEAT;
+    }
+    stack_slow = true;
+    ras_top = 0; // returns predicted from the shadow stack would skip their pops
+}
+
+// Code if it is a byte of the instruction being executed (instructions are
+// at most 3 bytes), stack if it is on the stack page, data otherwise.
+void CPU::heat_access(uint16_t addr, bool is_write)
+{
+    if (heat_paused)
+        return; // DMA or disk transfer, see run_events()
+    uint8_t kind;
+    if (!is_write && uint16_t(addr - op_pc) < 3)
+        kind = HeatMap::CODE;
+    else if ((addr >> 8) == (STACK_BASE >> 8))
+        kind = is_write ? HeatMap::STACK_WRITE : HeatMap::STACK_READ;
+    else
+        kind = is_write ? HeatMap::DATA_WRITE : HeatMap::DATA_READ;
+    heat->record(addr, kind, clock);
+}
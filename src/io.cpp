@@ -0,0 +1,227 @@
+#include "cpu.h"
+#include "smp.h"
+#include "console.h"
+#include <stdio.h>
+
+// Memory-mapped device registers. Unassigned addresses in the I/O page
+// behave like RAM so existing programs that only poke memory still work.
+
+uint8_t CPU::io_read(uint16_t addr)
+{
+    switch (addr)
+    {
+    case DMA_SRC_LO:
+        return dma.src & 0xFF;
+    case DMA_SRC_HI:
+        return dma.src >> 8;
+    case DMA_DST_LO:
+        return dma.dst & 0xFF;
+    case DMA_DST_HI:
+        return dma.dst >> 8;
+    case DMA_LEN_LO:
+        return dma.len & 0xFF;
+    case DMA_LEN_HI:
+        return dma.len >> 8;
+    case DMA_FILL:
+        return dma.fill;
+    case DMA_CTRL:
+        return dma.ctrl;
+    case BANK_SEL:
+    case BANK_SEL + 1:
+    case BANK_SEL + 2:
+    case BANK_SEL + 3:
+        return mmu.select[addr - BANK_SEL];
+    case BLK_CMD:
+        return blk.status;
+    case BLK_SECTOR_0:
+        return blk.sector & 0xFF;
+    case BLK_SECTOR_1:
+        return (blk.sector >> 8) & 0xFF;
+    case BLK_SECTOR_2:
+        return blk.sector >> 16;
+    case BLK_BUF_LO:
+        return blk.buf & 0xFF;
+    case BLK_BUF_HI:
+        return blk.buf >> 8;
+    case BLK_COUNT:
+        return blk.count;
+    case FB_FRAME:
+        return fb.sink ? uint8_t(fb.frame) : mem[addr];
+    case CON_DATA:
+        if (console)
+        {
+            int c = console->get();
+            return c < 0 ? 0 : uint8_t(c);
+        }
+        return mem[addr];
+    case CON_STATUS:
+        return console ? console->status() : mem[addr];
+    case CORE_ID:
+        return core_id;
+    case CORE_COUNT:
+        return smp ? uint8_t(smp->count()) : 1;
+    case MBOX_TARGET:
+        return mbox_target;
+    case MBOX_STATUS:
+        return uint8_t((smp && smp->pending(core_id) ? MBOX_RX_FULL : 0) | (mbox_send_failed ? MBOX_TX_FAILED : 0));
+    case MBOX_RECV:
+        return smp ? smp->receive(core_id) : 0;
+    default:
+        return mem[addr];
+    }
+}
+
+void CPU::io_write(uint16_t addr, uint8_t val)
+{
+    switch (addr)
+    {
+    // DMA registers are latched while a transfer is in flight.
+    case DMA_SRC_LO:
+        if (!(dma.ctrl & DMA_BUSY))
+            dma.src = (dma.src & 0xFF00) | val;
+        break;
+    case DMA_SRC_HI:
+        if (!(dma.ctrl & DMA_BUSY))
+            dma.src = (dma.src & 0x00FF) | (val << 8);
+        break;
+    case DMA_DST_LO:
+        if (!(dma.ctrl & DMA_BUSY))
+            dma.dst = (dma.dst & 0xFF00) | val;
+        break;
+    case DMA_DST_HI:
+        if (!(dma.ctrl & DMA_BUSY))
+            dma.dst = (dma.dst & 0x00FF) | (val << 8);
+        break;
+    case DMA_LEN_LO:
+        if (!(dma.ctrl & DMA_BUSY))
+            dma.len = (dma.len & 0xFF00) | val;
+        break;
+    case DMA_LEN_HI:
+        if (!(dma.ctrl & DMA_BUSY))
+            dma.len = (dma.len & 0x00FF) | (val << 8);
+        break;
+    case DMA_FILL:
+        if (!(dma.ctrl & DMA_BUSY))
+            dma.fill = val;
+        break;
+    case DMA_CTRL:
+        if (dma.ctrl & DMA_BUSY)
+            break; // registers are latched until the transfer lands
+        dma.ctrl = val & DMA_MODE_FILL;
+        if (val & DMA_START)
+        {
+            dma.ctrl |= DMA_BUSY;
+            dma.done_at = clock + uint64_t(dma.len) * DMA_CYCLES_PER_BYTE;
+            schedule_events();
+        }
+        break;
+    case BANK_SEL:
+    case BANK_SEL + 1:
+    case BANK_SEL + 2:
+    case BANK_SEL + 3:
+        select_bank(addr - BANK_SEL, val);
+        break;
+    case BLK_CMD:
+        blk_command(val);
+        break;
+    // Block device registers are latched while a transfer is in flight.
+    case BLK_SECTOR_0:
+        if (!(blk.status & BLK_BUSY))
+            blk.sector = (blk.sector & 0xFFFF00) | val;
+        break;
+    case BLK_SECTOR_1:
+        if (!(blk.status & BLK_BUSY))
+            blk.sector = (blk.sector & 0xFF00FF) | (val << 8);
+        break;
+    case BLK_SECTOR_2:
+        if (!(blk.status & BLK_BUSY))
+            blk.sector = (blk.sector & 0x00FFFF) | (uint32_t(val) << 16);
+        break;
+    case BLK_BUF_LO:
+        if (!(blk.status & BLK_BUSY))
+            blk.buf = (blk.buf & 0xFF00) | val;
+        break;
+    case BLK_BUF_HI:
+        if (!(blk.status & BLK_BUSY))
+            blk.buf = (blk.buf & 0x00FF) | (val << 8);
+        break;
+    case BLK_COUNT:
+        if (!(blk.status & BLK_BUSY))
+            blk.count = val;
+        break;
+    case FB_PAL_INDEX:
+        if (fb.sink)
+        {
+            fb.pal_index = val;
+            fb.pal_component = 0;
+        }
+        else
+            mem[addr] = val;
+        break;
+    case FB_PAL_DATA:
+        if (fb.sink)
+            fb_palette_write(val);
+        else
+            mem[addr] = val;
+        break;
+    case CON_DATA:
+        if (console)
+            console->put(val);
+        else
+            mem[addr] = val;
+        break;
+    case CORE_ID:
+    case CORE_COUNT:
+    case MBOX_STATUS:
+    case MBOX_RECV:
+        break; // read-only
+    case MBOX_TARGET:
+        mbox_target = val;
+        break;
+    case MBOX_SEND:
+        mbox_send_failed = !(smp && smp->send(mbox_target, val));
+        break;
+    default:
+        mem[addr] = val;
+        break;
+    }
+}
+
+// Called from step() once clock reaches next_event.
+void CPU::run_events()
+{
+    if ((dma.ctrl & DMA_BUSY) && clock >= dma.done_at)
+    {
+        uint32_t wait = access_wait; // DMA timing is its own, not the instruction's
+        heat_paused = true;          // nor are its accesses counted as the CPU's
+        if (dma.ctrl & DMA_MODE_FILL)
+            block_fill(dma.dst, dma.fill, dma.len);
+        else
+            block_copy(dma.dst, dma.src, dma.len);
+        heat_paused = false;
+        access_wait = wait;
+        dma.ctrl &= ~DMA_BUSY;
+    }
+    if ((blk.status & BLK_BUSY) && clock >= blk.done_at)
+    {
+        uint32_t wait = access_wait;
+        heat_paused = true;
+        blk_complete();
+        heat_paused = false;
+        access_wait = wait;
+    }
+    if (clock >= fb.next_frame)
+        fb_frame();
+    schedule_events();
+}
+
+void CPU::schedule_events()
+{
+    next_event = UINT64_MAX;
+    if ((dma.ctrl & DMA_BUSY) && dma.done_at < next_event)
+        next_event = dma.done_at;
+    if ((blk.status & BLK_BUSY) && blk.done_at < next_event)
+        next_event = blk.done_at;
+    if (fb.next_frame < next_event)
+        next_event = fb.next_frame;
+}
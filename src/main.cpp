@@ -1,62 +1,381 @@
 // do Not erase:999999999999
 #include "cpu.h"
 #include "rom.h"
+#include "mapped_file.h"
+#include "gdb_stub.h"
+#include "fuzz.h"
+#include "pacer.h"
+#include "state.h"
+#include "smp.h"
+#include "console.h"
+#include "fb.h"
+#include "superop.h"
+#include "heat.h"
+#include "run.h"
+#include "core.h"
 #include <iostream>
 #include <iomanip>
 #include <algorithm>
 #include <stdexcept>
 #include <cstring>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <memory>
 
-static void dump_memory(const CPU& cpu, uint16_t start, uint16_t end) {
-    for (uint16_t addr = start; addr <= end; addr += 16) {
-        std::cout << std::hex << std::setw(4) << std::setfill('0') << addr << ": ";
-        for (int i = 0; i < 16 && addr + i <= end; ++i) {
-            std::cout << std::setw(2) << int(cpu.mem[addr + i]) << " ";
+// Hex dump, 16 bytes per line, formatted into one buffer and written at once.
+// Reads through host_ptr() so bank windows show their selected bank.
+static void dump_memory(CPU& cpu, uint16_t start, uint16_t end) {
+    static const char HEX[] = "0123456789abcdef";
+    std::string out;
+    out.reserve((size_t(end - start) / 16 + 1) * 55);
+    for (uint32_t addr = start; addr <= end; addr += 16) {
+        char line[4 + 2 + 16 * 3 + 1], *p = line;
+        for (int shift = 12; shift >= 0; shift -= 4) *p++ = HEX[addr >> shift & 15];
+        *p++ = ':';
+        *p++ = ' ';
+        for (uint32_t a = addr; a < addr + 16 && a <= end; ++a) {
+            uint8_t b = *cpu.host_ptr(uint16_t(a));
+            *p++ = HEX[b >> 4];
+            *p++ = HEX[b & 15];
+            *p++ = ' ';
         }
-        std::cout << "\n";
+        *p++ = '\n';
+        out.append(line, p);
     }
+    std::cout.write(out.data(), std::streamsize(out.size()));
 }
 
 int main(int argc, char* argv[]) {
     if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " <romfile> [--trace] [--run] [--dump]\n";
+        std::cerr << "Usage: " << argv[0] << " <romfile> [--trace] [--run] [--dump | --dump-range START-END] [--check-stack]\n"
+                  << "       " << argv[0] << " --load-state PATH [options]\n"
+                  << "       [--banks N | --bank-file PATH] [--bank-window BASE,KB,COUNT]\n"
+                  << "       [--break ADDR]... [--watch ADDR]... [--gdb PORT | --gdb unix:PATH]\n"
+                  << "       [--fuzz DIR --fuzz-input ADDR,MAXLEN [--fuzz-len ADDR] [--fuzz-at ADDR]\n"
+                  << "        [--fuzz-cycles N] [--fuzz-execs N] [--fuzz-seed N]]\n"
+                  << "       [--wait START-END:READ[,WRITE]]... [--clock HZ [--quantum US]]\n"
+                  << "       [--save-state PATH (--save-at-pc ADDR | --save-at-cycle N)]\n"
+                  << "       [--smp N [--shared START-END]...] [--console PATH] [--disk PATH [--disk-size KB]]\n"
+                  << "       [(--fb-ppm DIR | --fb-raw PATH) [--fb-interval CYCLES]] [--profile-ops | --fuse]\n"
+                  << "       [--heatmap PATH [--heat-window CYCLES]] [--core PATH]\n";
         return 1;
     }
 
     bool trace = false;
     bool run_until_halt = false;
     bool dump_after = false;
+    unsigned long dump_start = 0x0000, dump_end = 0x00FF;
+    const char* core_path = nullptr;
+    bool check_stack = false;
+    unsigned long bank_count = 0;
+    const char* bank_file = nullptr;
+    unsigned long bank_base = 0x8000, bank_kb = 8, bank_windows = 2;
+    std::vector<uint16_t> breakpoints, watchpoints;
+    const char* gdb_spec = nullptr;
+    FuzzConfig fuzz_cfg;
+    struct WaitRange { unsigned long start, end, read_wait, write_wait; };
+    std::vector<WaitRange> waits;
+    double clock_hz = 0;
+    unsigned long quantum_us = 1000;
+    const char* save_path = nullptr;
+    const char* load_path = nullptr;
+    long save_pc = -1;
+    uint64_t save_cycle = UINT64_MAX;
+    unsigned long smp_cores = 0;
+    const char* console_path = nullptr; // guest console output, stdout if not given
+    const char* disk_path = nullptr;
+    unsigned long disk_kb = 0; // create or grow the disk image to this size
+    const char* fb_ppm_dir = nullptr;
+    const char* fb_raw_path = nullptr;
+    unsigned long fb_interval = 50000; // 60 frames/s at 3 MHz
+    std::vector<std::pair<unsigned long, unsigned long>> shared_ranges;
+    bool profile_ops = false; // count opcode pairs and triples
+    bool fuse = false;        // run fused opcode pairs in one dispatch
+    const char* heat_path = nullptr;
+    unsigned long heat_window = 100000; // cycles per working-set window
 
     const char* rom_path = nullptr;
     for (int i = 1; i < argc; ++i) {
+        bool has_value = i + 1 < argc;
         if (std::strcmp(argv[i], "--trace") == 0) trace = true;
         else if (std::strcmp(argv[i], "--run") == 0) run_until_halt = true;
         else if (std::strcmp(argv[i], "--dump") == 0) dump_after = true;
+        else if (std::strcmp(argv[i], "--check-stack") == 0) check_stack = true;
+        else if (std::strcmp(argv[i], "--profile-ops") == 0) profile_ops = true;
+        else if (std::strcmp(argv[i], "--fuse") == 0) fuse = true;
+        else if (std::strcmp(argv[i], "--banks") == 0 && has_value) bank_count = std::strtoul(argv[++i], nullptr, 0);
+        else if (std::strcmp(argv[i], "--bank-file") == 0 && has_value) bank_file = argv[++i];
+        else if (std::strcmp(argv[i], "--break") == 0 && has_value) breakpoints.push_back(uint16_t(std::strtoul(argv[++i], nullptr, 0)));
+        else if (std::strcmp(argv[i], "--watch") == 0 && has_value) watchpoints.push_back(uint16_t(std::strtoul(argv[++i], nullptr, 0)));
+        else if (std::strcmp(argv[i], "--gdb") == 0 && has_value) gdb_spec = argv[++i];
+        else if (std::strcmp(argv[i], "--fuzz") == 0 && has_value) fuzz_cfg.corpus_dir = argv[++i];
+        else if (std::strcmp(argv[i], "--fuzz-input") == 0 && has_value) {
+            char* p = argv[++i];
+            fuzz_cfg.input_addr = uint16_t(std::strtoul(p, &p, 0));
+            if (*p == ',') fuzz_cfg.input_max = uint16_t(std::strtoul(p + 1, &p, 0));
+        }
+        else if (std::strcmp(argv[i], "--fuzz-len") == 0 && has_value) fuzz_cfg.len_addr = int32_t(std::strtoul(argv[++i], nullptr, 0));
+        else if (std::strcmp(argv[i], "--fuzz-at") == 0 && has_value) fuzz_cfg.start_pc = int32_t(std::strtoul(argv[++i], nullptr, 0));
+        else if (std::strcmp(argv[i], "--fuzz-cycles") == 0 && has_value) fuzz_cfg.max_cycles = std::strtoull(argv[++i], nullptr, 0);
+        else if (std::strcmp(argv[i], "--fuzz-execs") == 0 && has_value) fuzz_cfg.max_execs = std::strtoull(argv[++i], nullptr, 0);
+        else if (std::strcmp(argv[i], "--fuzz-seed") == 0 && has_value) fuzz_cfg.seed = std::strtoull(argv[++i], nullptr, 0);
+        else if (std::strcmp(argv[i], "--wait") == 0 && has_value) {
+            char* p = argv[++i];
+            WaitRange w{};
+            w.start = std::strtoul(p, &p, 0);
+            w.end = w.start;
+            if (*p == '-') w.end = std::strtoul(p + 1, &p, 0);
+            if (*p == ':') w.read_wait = std::strtoul(p + 1, &p, 0);
+            w.write_wait = w.read_wait;
+            if (*p == ',') w.write_wait = std::strtoul(p + 1, &p, 0);
+            waits.push_back(w);
+        }
+        else if (std::strcmp(argv[i], "--clock") == 0 && has_value) clock_hz = std::strtod(argv[++i], nullptr);
+        else if (std::strcmp(argv[i], "--quantum") == 0 && has_value) quantum_us = std::strtoul(argv[++i], nullptr, 0);
+        else if (std::strcmp(argv[i], "--save-state") == 0 && has_value) save_path = argv[++i];
+        else if (std::strcmp(argv[i], "--save-at-pc") == 0 && has_value) save_pc = long(std::strtoul(argv[++i], nullptr, 0) & 0xFFFF);
+        else if (std::strcmp(argv[i], "--save-at-cycle") == 0 && has_value) save_cycle = std::strtoull(argv[++i], nullptr, 0);
+        else if (std::strcmp(argv[i], "--load-state") == 0 && has_value) load_path = argv[++i];
+        else if (std::strcmp(argv[i], "--disk") == 0 && has_value) disk_path = argv[++i];
+        else if (std::strcmp(argv[i], "--disk-size") == 0 && has_value) disk_kb = std::strtoul(argv[++i], nullptr, 0);
+        else if (std::strcmp(argv[i], "--fb-ppm") == 0 && has_value) fb_ppm_dir = argv[++i];
+        else if (std::strcmp(argv[i], "--fb-raw") == 0 && has_value) fb_raw_path = argv[++i];
+        else if (std::strcmp(argv[i], "--fb-interval") == 0 && has_value) fb_interval = std::strtoul(argv[++i], nullptr, 0);
+        else if (std::strcmp(argv[i], "--console") == 0 && has_value) console_path = argv[++i];
+        else if (std::strcmp(argv[i], "--heatmap") == 0 && has_value) heat_path = argv[++i];
+        else if (std::strcmp(argv[i], "--heat-window") == 0 && has_value) heat_window = std::strtoul(argv[++i], nullptr, 0);
+        else if (std::strcmp(argv[i], "--smp") == 0 && has_value) smp_cores = std::strtoul(argv[++i], nullptr, 0);
+        else if (std::strcmp(argv[i], "--dump-range") == 0 && has_value) {
+            char* p = argv[++i];
+            dump_start = std::strtoul(p, &p, 0) & 0xFFFF;
+            dump_end = dump_start;
+            if (*p == '-') dump_end = std::strtoul(p + 1, &p, 0) & 0xFFFF;
+            dump_after = true;
+        }
+        else if (std::strcmp(argv[i], "--core") == 0 && has_value) core_path = argv[++i];
+        else if (std::strcmp(argv[i], "--shared") == 0 && has_value) {
+            char* p = argv[++i];
+            unsigned long start = std::strtoul(p, &p, 0), end = start;
+            if (*p == '-') end = std::strtoul(p + 1, &p, 0);
+            shared_ranges.push_back({start, end});
+        }
+        else if (std::strcmp(argv[i], "--bank-window") == 0 && has_value) {
+            char* p = argv[++i];
+            bank_base = std::strtoul(p, &p, 0);
+            if (*p == ',') bank_kb = std::strtoul(p + 1, &p, 0);
+            if (*p == ',') bank_windows = std::strtoul(p + 1, &p, 0);
+        }
         else rom_path = argv[i];
     }
 
-    if (!rom_path) {
+    if (!rom_path && !load_path) {
         std::cerr << "Error: No ROM file specified.\n";
         return 1;
     }
+    if (save_path && save_pc < 0 && save_cycle == UINT64_MAX) {
+        std::cerr << "Error: --save-state needs --save-at-pc or --save-at-cycle.\n";
+        return 1;
+    }
+    // A fused pair has no boundary between its instructions for the trace,
+    // the save check or the debugger to stop at.
+    if (fuse && (profile_ops || trace || save_path || gdb_spec || !waits.empty())) {
+        std::cerr << "Error: --fuse cannot be combined with --profile-ops, --trace, --save-state, --gdb or --wait.\n";
+        return 1;
+    }
+    // Disk writes go straight to the mapped image and would leak from one
+    // fuzz exec into the next.
+    if (disk_path && fuzz_cfg.corpus_dir) {
+        std::cerr << "Error: --disk cannot be combined with --fuzz.\n";
+        return 1;
+    }
+    // Frames are written by whichever exec reaches them, and the frame
+    // counter is not part of the snapshot each exec restores.
+    if ((fb_ppm_dir || fb_raw_path) && fuzz_cfg.corpus_dir) {
+        std::cerr << "Error: --fb-ppm and --fb-raw cannot be combined with --fuzz.\n";
+        return 1;
+    }
+    if (core_path && (!run_until_halt || gdb_spec || fuzz_cfg.corpus_dir)) {
+        std::cerr << "Error: --core needs --run and cannot be combined with --gdb or --fuzz.\n";
+        return 1;
+    }
+    if (dump_end < dump_start) {
+        std::cerr << "Error: --dump-range end is below its start.\n";
+        return 1;
+    }
 
     try {
-        Rom rom = load_rom(rom_path);
+        if (smp_cores) {
+            // SMP: every core starts at the ROM origin and tells itself
+            // apart by reading CORE_ID. Runs to completion, no debugger.
+            if (!rom_path || load_path || gdb_spec || fuzz_cfg.corpus_dir || bank_count || bank_file || disk_path || fb_ppm_dir || fb_raw_path || clock_hz > 0 || profile_ops || fuse || heat_path || core_path) {
+                std::cerr << "Error: --smp needs a ROM and cannot be combined with banks, disks, the framebuffer, states, --gdb, --fuzz, --clock, --profile-ops, --fuse, --heatmap or --core.\n";
+                return 1;
+            }
+            Rom rom = load_rom(rom_path);
+            Smp smp(int(smp_cores), waits.empty() ? CPU::TIMING_FIXED : CPU::TIMING_WAIT_STATES);
+            smp.load(rom.origin, rom.data);
+            for (const auto& r : shared_ranges)
+                smp.set_shared(uint16_t(r.first), uint16_t(r.second));
+            for (int c = 0; c < smp.count(); ++c) {
+                CPU& core = smp.core(c);
+                for (const WaitRange& w : waits)
+                    core.set_wait_states(uint16_t(w.start), uint16_t(w.end), uint8_t(w.read_wait), uint8_t(w.write_wait));
+                core.set_stack_checked(check_stack);
+                core.quiet = true;
+            }
+            Console console(console_path); // core 0 only: the rings have one producer
+            smp.core(0).console = &console;
+            // Cores spinning on each other burn cycles while the host
+            // schedules the others, so the cap is far above MAX_STEPS.
+            smp.run(100000000);
+            console.close();
+            for (int c = 0; c < smp.count(); ++c) {
+                const CPU& core = smp.core(c);
+                std::cout << "Core " << c << (core._halted ? ": HALT at PC=" : ": running at PC=")
+                          << std::hex << (core._halted ? core.PC - 1 : core.PC)
+                          << "  A=" << int(core.A) << "  X=" << int(core.X)
+                          << "  after " << std::dec << core.clock << " cycles\n";
+            }
+            if (dump_after) dump_memory(smp.core(0), uint16_t(dump_start), uint16_t(dump_end));
+            return 0;
+        }
+
+        CPU cpu(waits.empty() ? CPU::TIMING_FIXED : CPU::TIMING_WAIT_STATES);
+        for (const WaitRange& w : waits)
+            cpu.set_wait_states(uint16_t(w.start), uint16_t(w.end), uint8_t(w.read_wait), uint8_t(w.write_wait));
+
+        // Bank backing store: an anonymous buffer or a mapped file.
+        std::vector<uint8_t> bank_mem;
+        MappedFile bank_map;
+        if (bank_file) {
+            bank_map.open(bank_file, MappedFile::MAP_SHARED);
+            cpu.map_banks(bank_map.data, bank_map.size, uint16_t(bank_base), uint32_t(bank_kb * 1024), int(bank_windows));
+        } else if (bank_count) {
+            bank_mem.resize(bank_count * bank_kb * 1024);
+            cpu.map_banks(bank_mem.data(), bank_mem.size(), uint16_t(bank_base), uint32_t(bank_kb * 1024), int(bank_windows));
+        }
+
+        // Block device disk image, mapped shared so guest writes persist.
+        MappedFile disk_map;
+        if (disk_path) {
+            disk_map.open(disk_path, MappedFile::MAP_SHARED, size_t(disk_kb) * 1024);
+            cpu.attach_disk(disk_map.data, disk_map.size);
+        }
+
+        // Framebuffer frames, exported every fb_interval cycles when changed.
+        // Attached before a state load, which restores its frame counter and
+        // palette.
+        std::unique_ptr<FrameSink> frames;
+        if (fb_ppm_dir || fb_raw_path) {
+            frames.reset(fb_ppm_dir ? new FrameSink(FrameSink::SINK_PPM, fb_ppm_dir)
+                                    : new FrameSink(FrameSink::SINK_RAW, fb_raw_path));
+            cpu.attach_framebuffer(frames.get(), uint32_t(fb_interval));
+        }
 
-        CPU cpu;
-        std::copy(rom.data.begin(), rom.data.end(), cpu.mem + rom.origin);
-        cpu.reset(rom.origin);
+        // Warm start from a saved image, or cold start from the ROM. The
+        // image is mapped copy-on-write and has to stay open while cpu runs.
+        MappedFile state_map;
+        if (load_path) {
+            load_state(cpu, state_map, load_path);
+        } else {
+            Rom rom = load_rom(rom_path);
+            for (size_t i = 0; i < rom.data.size(); ++i)
+                *cpu.host_ptr(uint16_t(rom.origin + i)) = rom.data[i];
+            cpu.reset(rom.origin);
+        }
+        cpu.set_stack_checked(check_stack);
+        cpu.trap_unknown = core_path != nullptr; // a core instead of running them as NOP
+        for (uint16_t addr : breakpoints) cpu.set_breakpoint(addr, true);
+        for (uint16_t addr : watchpoints) cpu.set_watchpoint(addr, true, true);
+
+        if (fuzz_cfg.corpus_dir) {
+            fuzz(cpu, fuzz_cfg);
+            return 0;
+        }
 
-        size_t steps = 0;
-        const size_t MAX_STEPS = 1000000; // safety cap
+        // Guest console output is written by a background thread; it is
+        // flushed before anything main prints itself.
+        Console console(console_path);
+        cpu.console = &console;
+
+        if (gdb_spec) {
+            GdbStub gdb(cpu);
+            gdb.listen(gdb_spec);
+            gdb.serve();
+            return 0;
+        }
+
+        std::unique_ptr<OpProfile> op_profile;
+        if (profile_ops) {
+            op_profile.reset(new OpProfile);
+            cpu.op_profile = op_profile.get();
+            cpu.superop = CPU::SUPEROP_PROFILE;
+        } else if (fuse) {
+            cpu.superop = CPU::SUPEROP_FUSE;
+        }
+
+        // Access counts and working set, written to heat_path at the end.
+        std::unique_ptr<HeatMap> heat;
+        if (heat_path) {
+            heat.reset(new HeatMap(uint32_t(heat_window)));
+            cpu.attach_heatmap(heat.get());
+        }
+
+        const uint64_t MAX_STEPS = 1000000; // safety cap in cycles, not applied when paced
 
         if (run_until_halt) {
-            while (steps < MAX_STEPS) {
+            // Real-time pacing: run in quanta of cycles, sleeping between them.
+            std::unique_ptr<Pacer> pacer;
+            uint64_t next_pace = UINT64_MAX;
+            if (clock_hz > 0) {
+                pacer.reset(new Pacer(clock_hz, uint32_t(quantum_us)));
+                pacer->start(cpu.clock);
+                next_pace = cpu.clock + pacer->quantum_cycles();
+            }
+            const uint64_t limit = pacer ? UINT64_MAX : cpu.clock + MAX_STEPS;
+            for (;;) {
+                // Save once, at the first instruction boundary at the save
+                // PC or past the save cycle, before that instruction runs.
+                if (save_path && !cpu._halted && cpu.cycles == 0 &&
+                    (cpu.PC == save_pc || cpu.clock >= save_cycle)) {
+                    save_state(cpu, save_path);
+                    std::cout << "Saved state to " << save_path << " at PC=" << std::hex << cpu.PC
+                              << " after " << std::dec << cpu.clock << " cycles\n";
+                    save_path = nullptr;
+                }
+                if (cpu._halted) console.flush();
+                if (cpu._halted && cpu.stop == CPU::STOP_BREAKPOINT) {
+                    std::cout << "BREAK at PC=" << std::hex << cpu.PC
+                              << "  A=" << int(cpu.A) << "  X=" << int(cpu.X) << "\n";
+                    cpu.resume();
+                } else if (cpu._halted && cpu.stop == CPU::STOP_WATCHPOINT) {
+                    std::cout << "WATCH " << (cpu.watch_was_write ? "write" : "read")
+                              << " $" << std::hex << cpu.watch_addr << " at PC=" << cpu.op_pc
+                              << "  A=" << int(cpu.A) << "  X=" << int(cpu.X) << "\n";
+                    cpu.resume();
+                }
                 if (cpu._halted) { // HALT flag true, cheating a bit.
-                    std::cout << "HALT at PC=" << std::hex << cpu.PC-1 << "\n";
+                    std::cout << "HALT at PC=" << std::hex << cpu.PC-1
+                              << "  A=" << int(cpu.A) << "  X=" << int(cpu.X)
+                              << "  after " << std::dec << cpu.clock << " cycles\n";
                     break;
                 }
-                cpu.step();
+                if (cpu.clock >= limit) break;
+
+                // Run up to whatever needs the host next: the cap, the
+                // pacer, the save point, or the next trace line.
+                uint64_t end = std::min(limit, next_pace);
+                if (trace) end = std::min(end, cpu.clock + 1);
+                if (!save_path) {
+                    cpu.run_until(UntilCycle(end));
+                } else if (cpu.clock >= save_cycle) {
+                    cpu.run_until(InstructionBudget(0)); // to the next boundary
+                } else if (save_pc >= 0) {
+                    cpu.run_until(any_of(UntilCycle(std::min(end, save_cycle)), AtPc(uint16_t(save_pc))));
+                } else {
+                    cpu.run_until(UntilCycle(std::min(end, save_cycle)));
+                }
                 if (trace) {
                     std::cout << std::hex << std::setfill('0')
                               << "PC=" << std::setw(4) << cpu.PC
@@ -66,11 +385,21 @@ int main(int argc, char* argv[]) {
                               << "  P=" << std::setw(2) << int(cpu.P)
                               << "\n";
                 }
-                steps++;
+                if (cpu.clock >= next_pace) {
+                    pacer->wait(cpu.clock);
+                    next_pace += pacer->quantum_cycles();
+                }
+            }
+            if (pacer) pacer->report();
+            // Post-mortem core: the run halted, faulted or hit the step limit.
+            if (core_path) {
+                write_core(cpu, core_path);
+                std::cout << "Core written to " << core_path
+                          << (cpu._halted ? "" : " (step limit reached)") << "\n";
             }
         } else {
             // Fixed step mode
-            for (steps = 0; steps < 20; ++steps) {
+            for (int steps = 0; steps < 20; ++steps) {
                 cpu.step();
                 if (trace) {
                     std::cout << std::hex << std::setfill('0')
@@ -84,8 +413,22 @@ int main(int argc, char* argv[]) {
             }
         }
 
+        console.close();
+        if (frames) {
+            std::cout << "Frames: " << std::dec << cpu.fb.frame << " emitted, " << frames->written << " written\n";
+        }
+        if (op_profile) {
+            std::cout.flush();
+            op_profile->report(stdout, 16);
+        }
+        if (heat) {
+            heat->finish();
+            heat->save(heat_path);
+            std::cout.flush();
+            heat->summary(stdout);
+        }
         if (dump_after) {
-            dump_memory(cpu, 0x0000, 0x00FF); // dump first 256 bytes
+            dump_memory(cpu, uint16_t(dump_start), uint16_t(dump_end)); // first 256 bytes by default
         }
 
     } catch (const std::exception& e) {
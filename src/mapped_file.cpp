@@ -0,0 +1,136 @@
+#include "mapped_file.h"
+#include <stdexcept>
+#include <string>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+void MappedFile::open(const char *path, Mode mode, size_t min_size)
+{
+    close();
+    bool writable = mode == MAP_SHARED;
+    HANDLE f = CreateFileA(path, GENERIC_READ | (writable ? GENERIC_WRITE : 0),
+                           FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                           writable ? OPEN_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (f == INVALID_HANDLE_VALUE)
+        throw std::runtime_error(std::string("Cannot open ") + path);
+    LARGE_INTEGER len;
+    GetFileSizeEx(f, &len);
+    size_t file_size = size_t(len.QuadPart);
+    if (writable && file_size < min_size)
+        file_size = min_size;
+    if (file_size == 0)
+    {
+        CloseHandle(f);
+        throw std::runtime_error(std::string("Empty file ") + path);
+    }
+    DWORD protect = mode == MAP_READ ? PAGE_READONLY : mode == MAP_SHARED ? PAGE_READWRITE : PAGE_WRITECOPY;
+    HANDLE m = CreateFileMappingA(f, nullptr, protect, DWORD(uint64_t(file_size) >> 32),
+                                  DWORD(file_size & 0xFFFFFFFF), nullptr);
+    if (!m)
+    {
+        CloseHandle(f);
+        throw std::runtime_error(std::string("Cannot map ") + path);
+    }
+    DWORD access = mode == MAP_READ ? FILE_MAP_READ : mode == MAP_SHARED ? FILE_MAP_WRITE : FILE_MAP_COPY;
+    void *p = MapViewOfFile(m, access, 0, 0, file_size);
+    if (!p)
+    {
+        CloseHandle(m);
+        CloseHandle(f);
+        throw std::runtime_error(std::string("Cannot map ") + path);
+    }
+    file_handle = f;
+    map_handle = m;
+    data = static_cast<uint8_t *>(p);
+    size = file_size;
+}
+
+void MappedFile::close()
+{
+    if (data)
+        UnmapViewOfFile(data);
+    if (map_handle)
+        CloseHandle(map_handle);
+    if (file_handle)
+        CloseHandle(file_handle);
+    data = nullptr;
+    size = 0;
+    map_handle = file_handle = nullptr;
+}
+
+void MappedFile::sync()
+{
+    if (data)
+        FlushViewOfFile(data, size);
+}
+
+#else
+
+void MappedFile::open(const char *path, Mode mode, size_t min_size)
+{
+    close();
+    bool writable = mode == MAP_SHARED;
+    int f = ::open(path, writable ? (O_RDWR | O_CREAT) : O_RDONLY, 0644);
+    if (f < 0)
+        throw std::runtime_error(std::string("Cannot open ") + path);
+    struct stat st;
+    if (fstat(f, &st) != 0)
+    {
+        ::close(f);
+        throw std::runtime_error(std::string("Cannot stat ") + path);
+    }
+    size_t file_size = size_t(st.st_size);
+    if (writable && file_size < min_size)
+    {
+        if (ftruncate(f, off_t(min_size)) != 0)
+        {
+            ::close(f);
+            throw std::runtime_error(std::string("Cannot grow ") + path);
+        }
+        file_size = min_size;
+    }
+    if (file_size == 0)
+    {
+        ::close(f);
+        throw std::runtime_error(std::string("Empty file ") + path);
+    }
+    int prot = mode == MAP_READ ? PROT_READ : PROT_READ | PROT_WRITE;
+    int flags = mode == MAP_SHARED ? MAP_SHARED : MAP_PRIVATE;
+    void *p = mmap(nullptr, file_size, prot, flags, f, 0);
+    if (p == MAP_FAILED)
+    {
+        ::close(f);
+        throw std::runtime_error(std::string("Cannot map ") + path);
+    }
+    fd = f;
+    data = static_cast<uint8_t *>(p);
+    size = file_size;
+}
+
+void MappedFile::close()
+{
+    if (data)
+        munmap(data, size);
+    if (fd >= 0)
+        ::close(fd);
+    data = nullptr;
+    size = 0;
+    fd = -1;
+}
+
+void MappedFile::sync()
+{
+    if (data)
+        msync(data, size, MS_SYNC);
+}
+
+#endif
@@ -0,0 +1,81 @@
+#include "cpu.h"
+#include <stdexcept>
+#include <string.h>
+
+// Maps `windows` consecutive windows of `window_size` bytes starting at
+// `base` onto `backing`, which holds size / window_size banks. Window n
+// starts out on bank n so the windows read like linear memory until the
+// guest switches banks. The backing store must outlive the CPU.
+void CPU::map_banks(uint8_t *backing, size_t size, uint16_t base, uint32_t window_size, int windows)
+{
+    if (window_size != 0x1000 && window_size != 0x2000 && window_size != 0x4000)
+        throw std::runtime_error("Bank window size must be 4, 8 or 16 KiB");
+    if (windows < 1 || windows > MMU_MAX_WINDOWS)
+        throw std::runtime_error("Bad bank window count");
+    if (base % window_size != 0)
+        throw std::runtime_error("Bank window base must be aligned to the window size");
+    uint32_t end = uint32_t(base) + window_size * uint32_t(windows);
+    if (end > IO_BASE)
+        throw std::runtime_error("Bank windows overlap the I/O page");
+    if (STACK_BASE >= base && STACK_BASE < end)
+        throw std::runtime_error("Bank windows overlap the stack page");
+    size_t banks = size / window_size;
+    if (banks < size_t(windows))
+        throw std::runtime_error("Bank backing store too small");
+    if (banks > 256)
+        banks = 256; // the select registers are 8-bit
+
+    // Drop any previous mapping.
+    for (int page = 0; page < 256; page++)
+    {
+        page_read[page] &= ~PAGE_BANK;
+        page_write[page] &= ~PAGE_BANK;
+    }
+
+    mmu.backing = backing;
+    mmu.banks = banks;
+    mmu.base = base;
+    mmu.window_size = window_size;
+    mmu.shift = window_size == 0x1000 ? 12 : window_size == 0x2000 ? 13 : 14;
+    mmu.windows = windows;
+    for (int w = 0; w < windows; w++)
+        select_bank(w, uint8_t(w));
+
+    for (uint32_t page = base >> 8; page < end >> 8; page++)
+    {
+        page_read[page] |= PAGE_BANK;
+        page_write[page] |= PAGE_BANK;
+    }
+}
+
+void CPU::select_bank(int window, uint8_t bank)
+{
+    if (window >= mmu.windows)
+        return;
+    mmu.select[window] = bank;
+    mmu.window[window] = mmu.backing + size_t(bank % mmu.banks) * mmu.window_size;
+}
+
+// Host address backing a guest address, following the current bank
+// mapping. Used by read_slow()/write_slow() and by loaders.
+uint8_t *CPU::host_ptr(uint16_t addr)
+{
+    if (mmu.windows && (page_read[addr >> 8] & PAGE_BANK))
+    {
+        uint16_t off = addr - mmu.base;
+        return mmu.window[off >> mmu.shift] + (off & (mmu.window_size - 1));
+    }
+    if ((addr >> 8) == (STACK_BASE >> 8))
+        return stack_page() + (addr & 0xFF);
+    return mem + addr;
+}
+
+// Copies the 64 KiB the CPU currently sees into `out`, page by page through
+// host_ptr(): banked windows show their selected bank and the stack page
+// this core's own. Windows and the stack are whole pages, so each page is
+// one contiguous host range.
+void CPU::copy_address_space(uint8_t *out)
+{
+    for (uint32_t page = 0; page < 256; page++)
+        memcpy(out + (page << 8), host_ptr(uint16_t(page << 8)), 256);
+}
@@ -0,0 +1,66 @@
+#include "pacer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <stdexcept>
+#include <thread>
+
+Pacer::Pacer(double hz, uint32_t quantum_us) : hz(hz)
+{
+    if (!(hz > 0))
+        throw std::runtime_error("Clock rate must be positive");
+    if (quantum_us == 0)
+        throw std::runtime_error("Pacing quantum must be positive");
+    quantum = uint64_t(std::llround(hz * quantum_us / 1e6));
+    if (quantum == 0)
+        quantum = 1;
+    // Allow a few quanta of backlog before giving up on catching up.
+    max_lag = std::chrono::microseconds(std::max<uint64_t>(uint64_t(quantum_us) * 20, 50000));
+}
+
+void Pacer::start(uint64_t cycle)
+{
+    anchor_time = start_time = clock::now();
+    anchor_cycle = start_cycle = last_cycle = cycle;
+}
+
+void Pacer::wait(uint64_t cycle)
+{
+    last_cycle = cycle;
+    waits++;
+    auto deadline = anchor_time + std::chrono::duration_cast<clock::duration>(
+                                      std::chrono::duration<double>((cycle - anchor_cycle) / hz));
+    auto now = clock::now();
+    if (now >= deadline)
+    {
+        late_waits++;
+        if (now - deadline > max_lag)
+        {
+            // Host can't keep up: drop the backlog and run at best effort.
+            slips++;
+            anchor_time = now;
+            anchor_cycle = cycle;
+        }
+        return;
+    }
+    std::this_thread::sleep_until(deadline);
+    double off = std::chrono::duration<double, std::micro>(clock::now() - deadline).count();
+    off = std::fabs(off);
+    jitter_sum_us += off;
+    if (off > jitter_max_us)
+        jitter_max_us = off;
+    sleeps++;
+}
+
+void Pacer::report() const
+{
+    double secs = std::chrono::duration<double>(clock::now() - start_time).count();
+    double achieved = secs > 0 ? (last_cycle - start_cycle) / secs : 0;
+    std::printf("[PACE] target %.3f MHz, achieved %.3f MHz over %.3f s\n", hz / 1e6, achieved / 1e6, secs);
+    std::printf("[PACE] %llu quanta of %llu cycles, jitter avg %.1f us max %.1f us, %llu late, %llu slips\n",
+                (unsigned long long)waits, (unsigned long long)quantum,
+                sleeps ? jitter_sum_us / sleeps : 0.0, jitter_max_us,
+                (unsigned long long)late_waits, (unsigned long long)slips);
+    if (slips)
+        std::printf("[PACE] host could not keep up; ran at best effort after each slip\n");
+}
@@ -10,20 +10,25 @@ Rom load_rom(const char* path) {
     if (!f) throw std::runtime_error("Cannot open ROM");
     std::vector<uint8_t> buf((std::istreambuf_iterator<char>(f)),
                               std::istreambuf_iterator<char>());
-    if (buf.size() < 12) throw std::runtime_error("ROM too small");
-    if (std::string((char*)buf.data(), 4) != "MR8C") throw std::runtime_error("Bad magic");
+    return parse_rom(buf.data(), buf.size());
+}
+
+// Parses an in-memory MR8C image (header + payload).
+Rom parse_rom(const uint8_t* buf, size_t size_bytes) {
+    if (size_bytes < 12) throw std::runtime_error("ROM too small");
+    if (std::string((const char*)buf, 4) != "MR8C") throw std::runtime_error("Bad magic");
     uint8_t ver = buf[4];
     if (ver != 1) throw std::runtime_error("Unsupported ROM version");
     uint16_t origin = buf[6] << 8 | buf[5];
     uint16_t size   = buf[8] << 8 | buf[7];
     uint16_t csum   = buf[10] << 8 | buf[9];
-    if (buf.size() != size) std::printf("Warning:ROM size mismatch\n");
+    if (size_bytes != size) std::printf("Warning:ROM size mismatch\n");
     uint16_t calc = 0;
-    for (size_t i = 12; i < buf.size(); ++i) calc = (calc + buf[i]) & 0xFFFF;
+    for (size_t i = 12; i < size_bytes; ++i) calc = (calc + buf[i]) & 0xFFFF;
     if (calc != csum) std::printf("Warning:ROM checksum mismatch\n");
     Rom rom;
     rom.origin = origin;
-    rom.data.assign(buf.begin() + 12, buf.end());
+    rom.data.assign(buf + 12, buf + size_bytes);
     return rom;
 }
 
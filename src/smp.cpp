@@ -0,0 +1,118 @@
+#include "smp.h"
+#include "run.h"
+#include <stdexcept>
+#include <thread>
+
+Smp::Smp(int count, uint8_t timing) : memory(65536), mailbox(new std::atomic<uint16_t>[MAX_CORES])
+{
+    if (count < 1 || count > MAX_CORES)
+        throw std::runtime_error("SMP core count must be 1-16");
+    for (int i = 0; i < MAX_CORES; i++)
+        mailbox[i].store(0, std::memory_order_relaxed);
+    for (int i = 0; i < count; i++)
+    {
+        cores.emplace_back(new CPU(timing));
+        CPU &cpu = *cores.back();
+        cpu.smp = this;
+        cpu.core_id = uint8_t(i);
+        cpu.mem = memory.data();
+        cpu.stack_mem = cpu.mem_buf + STACK_BASE; // private stack page
+        cpu.page_read[STACK_BASE >> 8] |= CPU::PAGE_STACK;
+    }
+}
+
+void Smp::load(uint16_t origin, const std::vector<uint8_t> &data)
+{
+    for (auto &cpu : cores)
+    {
+        for (size_t i = 0; i < data.size(); i++)
+            *cpu->host_ptr(uint16_t(origin + i)) = data[i];
+        cpu->reset(origin);
+    }
+}
+
+// Shared pages cannot overlap the stack page (private to each core) or the
+// I/O page (devices are per core).
+void Smp::set_shared(uint16_t start, uint16_t end)
+{
+    for (uint32_t page = start >> 8; page <= uint32_t(end >> 8); page++)
+    {
+        if (page == STACK_BASE >> 8 || page == IO_BASE >> 8)
+            throw std::runtime_error("Shared pages cannot include the stack or I/O page");
+        for (auto &cpu : cores)
+        {
+            cpu->page_read[page] |= CPU::PAGE_SHARED;
+            cpu->page_write[page] |= CPU::PAGE_SHARED;
+        }
+    }
+}
+
+void Smp::run(uint64_t max_cycles)
+{
+    // Hold every core until all threads exist, so thread start-up latency
+    // does not let the first cores run far ahead of the others.
+    std::atomic<int> ready{0};
+    std::vector<std::thread> threads;
+    for (auto &core : cores)
+    {
+        CPU *cpu = core.get();
+        threads.emplace_back([this, cpu, max_cycles, &ready] {
+            ready.fetch_add(1);
+            while (ready.load() < count())
+                std::this_thread::yield();
+            cpu->run_until(CycleBudget(max_cycles));
+        });
+    }
+    for (std::thread &t : threads)
+        t.join();
+}
+
+// Host byte for an atomic read-modify-write at `addr`, with the access's
+// wait states, watchpoints and shadow stack invalidation applied. Returns
+// nullptr for the I/O page, where TAS/CAS fall back to read() and write().
+uint8_t *CPU::atomic_ptr(uint16_t addr)
+{
+    uint16_t flags = page_read[addr >> 8] | page_write[addr >> 8];
+    if (flags & PAGE_IO)
+        return nullptr;
+    if (flags & PAGE_HEAT)
+    {
+        heat_access(addr, false);
+        heat_access(addr, true);
+    }
+    if (flags & PAGE_FRAME)
+        fb_mark(addr);
+    if (flags & PAGE_TRACK)
+    {
+        page_write[addr >> 8] &= ~PAGE_TRACK;
+        dirty_pages[dirty_count++] = addr >> 8;
+    }
+    if (flags & PAGE_WAIT)
+        access_wait += wait_read[addr >> 8] + wait_write[addr >> 8];
+    if (flags & PAGE_WATCH)
+    {
+        check_watch(addr, false);
+        check_watch(addr, true);
+    }
+    if (flags & PAGE_STACK)
+        ras_top = 0;
+    return host_ptr(addr);
+}
+
+bool Smp::send(int to, uint8_t value)
+{
+    if (to >= count())
+        return false;
+    uint16_t empty = 0;
+    return mailbox[to].compare_exchange_strong(empty, uint16_t(MBOX_FULL | value), std::memory_order_acq_rel);
+}
+
+bool Smp::pending(int core) const
+{
+    return mailbox[core].load(std::memory_order_acquire) & MBOX_FULL;
+}
+
+uint8_t Smp::receive(int core)
+{
+    return uint8_t(mailbox[core].exchange(0, std::memory_order_acq_rel));
+}
@@ -0,0 +1,222 @@
+#include "state.h"
+#include "cpu.h"
+#include "fb.h"
+#include "mapped_file.h"
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+
+// Header layout, little endian. Everything after the last field up to
+// STATE_MEM_OFFSET is zero.
+enum : size_t
+{
+    H_MAGIC = 0,       // "MR8S"
+    H_VERSION = 4,     // u16
+    H_CHUNKS = 6,      // u16, bit n set = memory chunk n is stored (not all zero)
+    H_A = 8,
+    H_X = 9,
+    H_SP = 10,
+    H_P = 11,
+    H_PC = 12,         // u16
+    H_OP_PC = 14,      // u16
+    H_BREAK_ADDR = 16, // u16
+    H_HALTED = 18,
+    H_STOP = 19,
+    H_FAULT = 20,
+    H_FAULT_PC = 22,   // u16
+    H_CYCLES = 24,     // u32, cycles left on the current instruction
+    H_CLOCK = 32,      // u64
+    H_DMA_SRC = 40,    // u16
+    H_DMA_DST = 42,    // u16
+    H_DMA_LEN = 44,    // u16
+    H_DMA_FILL = 46,
+    H_DMA_CTRL = 47,
+    H_DMA_DONE_AT = 48, // u64
+    H_BLK_SECTOR = 56,  // u32
+    H_BLK_BUF = 60,     // u16
+    H_BLK_COUNT = 62,
+    H_BLK_CMD = 63,
+    H_BLK_STATUS = 64,
+    H_BLK_DONE_AT = 72, // u64
+    H_FB_FRAME = 80,    // u32
+    H_FB_PAL_INDEX = 84,
+    H_FB_PAL_COMPONENT = 85,
+    H_FB_NEXT_FRAME = 88, // u64, UINT64_MAX = no framebuffer
+    H_FB_PALETTE = 96     // u8[256][3]
+};
+static_assert(H_FB_PALETTE + sizeof(Framebuffer::palette) <= STATE_MEM_OFFSET, "state header overflow");
+
+static void put(uint8_t *p, uint64_t v, int bytes)
+{
+    for (int i = 0; i < bytes; i++)
+        p[i] = uint8_t(v >> (8 * i));
+}
+
+static uint64_t get(const uint8_t *p, int bytes)
+{
+    uint64_t v = 0;
+    for (int i = 0; i < bytes; i++)
+        v |= uint64_t(p[i]) << (8 * i);
+    return v;
+}
+
+static bool all_zero(const uint8_t *p, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+        if (p[i])
+            return false;
+    return true;
+}
+
+void save_state(const CPU &cpu, const char *path)
+{
+    if (cpu.mmu.windows)
+        throw std::runtime_error("Cannot save state with bank switching enabled");
+
+    uint8_t h[STATE_MEM_OFFSET]{};
+    std::memcpy(h + H_MAGIC, "MR8S", 4);
+    put(h + H_VERSION, STATE_VERSION, 2);
+    h[H_A] = cpu.A;
+    h[H_X] = cpu.X;
+    h[H_SP] = cpu.SP;
+    h[H_P] = cpu.P;
+    put(h + H_PC, cpu.PC, 2);
+    put(h + H_OP_PC, cpu.op_pc, 2);
+    put(h + H_BREAK_ADDR, cpu.break_addr, 2);
+    h[H_HALTED] = cpu._halted;
+    h[H_STOP] = cpu.stop;
+    h[H_FAULT] = cpu.fault;
+    put(h + H_FAULT_PC, cpu.fault_pc, 2);
+    put(h + H_CYCLES, cpu.cycles, 4);
+    put(h + H_CLOCK, cpu.clock, 8);
+    put(h + H_DMA_SRC, cpu.dma.src, 2);
+    put(h + H_DMA_DST, cpu.dma.dst, 2);
+    put(h + H_DMA_LEN, cpu.dma.len, 2);
+    h[H_DMA_FILL] = cpu.dma.fill;
+    h[H_DMA_CTRL] = cpu.dma.ctrl;
+    put(h + H_DMA_DONE_AT, cpu.dma.done_at, 8);
+    put(h + H_BLK_SECTOR, cpu.blk.sector, 4);
+    put(h + H_BLK_BUF, cpu.blk.buf, 2);
+    h[H_BLK_COUNT] = cpu.blk.count;
+    h[H_BLK_CMD] = cpu.blk.cmd;
+    h[H_BLK_STATUS] = cpu.blk.status;
+    put(h + H_BLK_DONE_AT, cpu.blk.done_at, 8);
+    put(h + H_FB_NEXT_FRAME, cpu.fb.sink ? cpu.fb.next_frame : UINT64_MAX, 8);
+    if (cpu.fb.sink)
+    {
+        put(h + H_FB_FRAME, cpu.fb.frame, 4);
+        h[H_FB_PAL_INDEX] = cpu.fb.pal_index;
+        h[H_FB_PAL_COMPONENT] = cpu.fb.pal_component;
+        std::memcpy(h + H_FB_PALETTE, cpu.fb.palette, sizeof(cpu.fb.palette));
+    }
+
+    uint16_t chunks = 0;
+    for (size_t c = 0; c < 65536 / STATE_CHUNK; c++)
+        if (!all_zero(cpu.mem + c * STATE_CHUNK, STATE_CHUNK))
+            chunks |= uint16_t(1u << c);
+    put(h + H_CHUNKS, chunks, 2);
+
+    FILE *f = std::fopen(path, "wb");
+    if (!f)
+        throw std::runtime_error(std::string("Cannot create ") + path);
+    bool ok = std::fwrite(h, 1, sizeof(h), f) == sizeof(h);
+    for (size_t c = 0; ok && c < 65536 / STATE_CHUNK; c++)
+    {
+        if (!(chunks >> c & 1))
+            continue; // leave a hole
+        ok = std::fseek(f, long(STATE_MEM_OFFSET + c * STATE_CHUNK), SEEK_SET) == 0 &&
+             std::fwrite(cpu.mem + c * STATE_CHUNK, 1, STATE_CHUNK, f) == STATE_CHUNK;
+    }
+    ok = std::fclose(f) == 0 && ok;
+    if (!ok)
+        throw std::runtime_error(std::string("Cannot write ") + path);
+
+    // Trailing zero chunks: extend the file without writing them.
+    std::error_code ec;
+    std::filesystem::resize_file(path, STATE_SIZE, ec);
+    if (ec)
+        throw std::runtime_error(std::string("Cannot write ") + path);
+}
+
+void load_state(CPU &cpu, MappedFile &image, const char *path)
+{
+    if (cpu.mmu.windows)
+        throw std::runtime_error("Cannot load state with bank switching enabled");
+
+    image.open(path, MappedFile::MAP_COPY_ON_WRITE);
+    const uint8_t *h = image.data;
+    if (image.size < STATE_SIZE || std::memcmp(h + H_MAGIC, "MR8S", 4) != 0)
+    {
+        image.close();
+        throw std::runtime_error(std::string("Not a state image: ") + path);
+    }
+    if (get(h + H_VERSION, 2) != STATE_VERSION)
+    {
+        image.close();
+        throw std::runtime_error(std::string("Unsupported state version: ") + path);
+    }
+    // A transfer in flight lands on the disk attached now (--disk), which
+    // has to be large enough for it.
+    uint32_t blk_sector = uint32_t(get(h + H_BLK_SECTOR, 4));
+    if ((h[H_BLK_STATUS] & BLK_BUSY) && uint64_t(blk_sector) + h[H_BLK_COUNT] > cpu.blk.sectors)
+    {
+        image.close();
+        throw std::runtime_error(std::string("State has a disk transfer in flight; attach its disk: ") + path);
+    }
+    // Likewise the framebuffer, which has to be attached (--fb-ppm or
+    // --fb-raw) before the image is loaded.
+    uint64_t fb_next_frame = get(h + H_FB_NEXT_FRAME, 8);
+    if (fb_next_frame != UINT64_MAX && !cpu.fb.sink)
+    {
+        image.close();
+        throw std::runtime_error(std::string("State has a framebuffer; attach one: ") + path);
+    }
+
+    cpu.A = h[H_A];
+    cpu.X = h[H_X];
+    cpu.SP = h[H_SP];
+    cpu.P = h[H_P];
+    cpu.PC = uint16_t(get(h + H_PC, 2));
+    cpu.op_pc = uint16_t(get(h + H_OP_PC, 2));
+    cpu.break_addr = uint16_t(get(h + H_BREAK_ADDR, 2));
+    cpu._halted = h[H_HALTED] != 0;
+    cpu.stop = h[H_STOP];
+    cpu.fault = h[H_FAULT];
+    cpu.fault_pc = uint16_t(get(h + H_FAULT_PC, 2));
+    cpu.cycles = uint32_t(get(h + H_CYCLES, 4));
+    cpu.clock = get(h + H_CLOCK, 8);
+    cpu.dma.src = uint16_t(get(h + H_DMA_SRC, 2));
+    cpu.dma.dst = uint16_t(get(h + H_DMA_DST, 2));
+    cpu.dma.len = uint16_t(get(h + H_DMA_LEN, 2));
+    cpu.dma.fill = h[H_DMA_FILL];
+    cpu.dma.ctrl = h[H_DMA_CTRL];
+    cpu.dma.done_at = get(h + H_DMA_DONE_AT, 8);
+    cpu.blk.sector = blk_sector;
+    cpu.blk.buf = uint16_t(get(h + H_BLK_BUF, 2));
+    cpu.blk.count = h[H_BLK_COUNT];
+    cpu.blk.cmd = h[H_BLK_CMD];
+    cpu.blk.status = h[H_BLK_STATUS];
+    cpu.blk.done_at = get(h + H_BLK_DONE_AT, 8);
+    if (fb_next_frame != UINT64_MAX)
+    {
+        cpu.fb.frame = uint32_t(get(h + H_FB_FRAME, 4));
+        cpu.fb.next_frame = fb_next_frame;
+        cpu.fb.pal_index = h[H_FB_PAL_INDEX];
+        cpu.fb.pal_component = h[H_FB_PAL_COMPONENT];
+        std::memcpy(cpu.fb.palette, h + H_FB_PALETTE, sizeof(cpu.fb.palette));
+    }
+    else if (cpu.fb.sink)
+    {
+        cpu.fb.next_frame = cpu.clock + cpu.fb.interval; // a fresh framebuffer
+    }
+    // The last encoded frame is not saved: attach_framebuffer() left every
+    // page dirty, so the first frame after the load is encoded in full.
+
+    cpu.mem = image.data + STATE_MEM_OFFSET;
+    cpu.stack_mem = cpu.mem + STACK_BASE;
+    cpu.bp_resume_pc = -1;
+    cpu.ras_top = 0; // the shadow stack is not part of the image
+    cpu.schedule_events();
+}
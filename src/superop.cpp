@@ -0,0 +1,59 @@
+#include "superop.h"
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+const uint16_t FUSED_PAIRS[] = {FUSE_LDA_STA, FUSE_LDA_LDX, FUSE_LDA_DEC, FUSE_STA_LDA, FUSE_STA_BNZ,
+                                FUSE_LDI_STA, FUSE_DEC_BNZ, FUSE_SUBF_BZ, FUSE_PHA_PHX, FUSE_PLX_PLA};
+const size_t FUSED_PAIR_COUNT = sizeof(FUSED_PAIRS) / sizeof(FUSED_PAIRS[0]);
+
+void OpProfile::record(uint8_t op, bool control)
+{
+    ops++;
+    if (run >= 1)
+        pairs[last[0] << 8 | op]++;
+    if (run >= 2)
+        triples[uint32_t(last[1]) << 16 | last[0] << 8 | op]++;
+    if (control)
+    {
+        run = 0;
+        return;
+    }
+    last[1] = last[0];
+    last[0] = op;
+    if (run < 2)
+        run++;
+}
+
+static bool is_fused(uint16_t pair)
+{
+    return std::find(FUSED_PAIRS, FUSED_PAIRS + FUSED_PAIR_COUNT, pair) != FUSED_PAIRS + FUSED_PAIR_COUNT;
+}
+
+void OpProfile::report(FILE *out, size_t top) const
+{
+    std::vector<std::pair<uint64_t, uint32_t>> hot; // count, sequence
+    for (uint32_t i = 0; i < 65536; i++)
+        if (pairs[i])
+            hot.push_back({pairs[i], i});
+    size_t n = std::min(top, hot.size());
+    std::partial_sort(hot.begin(), hot.begin() + n, hot.end(), std::greater<>());
+
+    double total = ops ? double(ops) : 1.0;
+    std::fprintf(out, "[OPS] %llu instructions\n", (unsigned long long)ops);
+    std::fprintf(out, "[OPS] top pairs (* = fused):\n");
+    for (size_t i = 0; i < n; i++)
+        std::fprintf(out, "[OPS]   %02X %02X     %12llu  %5.1f%%%s\n", hot[i].second >> 8, hot[i].second & 0xFF,
+                     (unsigned long long)hot[i].first, 100.0 * hot[i].first / total,
+                     is_fused(uint16_t(hot[i].second)) ? "  *" : "");
+
+    hot.clear();
+    for (const auto &t : triples)
+        hot.push_back({t.second, t.first});
+    n = std::min(top, hot.size());
+    std::partial_sort(hot.begin(), hot.begin() + n, hot.end(), std::greater<>());
+    std::fprintf(out, "[OPS] top triples:\n");
+    for (size_t i = 0; i < n; i++)
+        std::fprintf(out, "[OPS]   %02X %02X %02X  %12llu  %5.1f%%\n", hot[i].second >> 16, (hot[i].second >> 8) & 0xFF,
+                     hot[i].second & 0xFF, (unsigned long long)hot[i].first, 100.0 * hot[i].first / total);
+}
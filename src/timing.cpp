@@ -0,0 +1,26 @@
+#include "cpu.h"
+#include <stdexcept>
+
+// Gives the pages covering [start, end] `read_wait`/`write_wait` extra
+// cycles per access. Only pages with wait states are flagged, so the rest
+// of memory keeps the plain fast path.
+void CPU::set_wait_states(uint16_t start, uint16_t end, uint8_t read_wait, uint8_t write_wait)
+{
+    if (timing_model != TIMING_WAIT_STATES)
+        throw std::runtime_error("Wait states need the wait-state timing model");
+    if (end < start)
+        throw std::runtime_error("Bad wait-state range");
+    for (uint32_t page = start >> 8; page <= uint32_t(end >> 8); page++)
+    {
+        wait_read[page] = read_wait;
+        wait_write[page] = write_wait;
+        if (read_wait)
+            page_read[page] |= PAGE_WAIT;
+        else
+            page_read[page] &= ~PAGE_WAIT;
+        if (write_wait)
+            page_write[page] |= PAGE_WAIT;
+        else
+            page_write[page] &= ~PAGE_WAIT;
+    }
+}
@@ -0,0 +1,150 @@
+#include "vcpu.h"
+#include "cpu.h"
+#include "rom.h"
+#include "run.h"
+#include <exception>
+#include <new>
+#include <string>
+
+struct vcpu
+{
+    CPU cpu;
+    std::string error;
+};
+
+vcpu *vcpu_create(void)
+{
+    vcpu *v = new (std::nothrow) vcpu;
+    if (v)
+        v->cpu.quiet = true; // hosts get the stop reason from vcpu_run()
+    return v;
+}
+
+void vcpu_destroy(vcpu *v)
+{
+    delete v;
+}
+
+const char *vcpu_last_error(const vcpu *v)
+{
+    return v->error.c_str();
+}
+
+int vcpu_load_rom(vcpu *v, const uint8_t *image, size_t size)
+{
+    try
+    {
+        Rom rom = parse_rom(image, size);
+        for (size_t i = 0; i < rom.data.size(); i++)
+            *v->cpu.host_ptr(uint16_t(rom.origin + i)) = rom.data[i];
+        v->cpu.reset(rom.origin);
+        return 0;
+    }
+    catch (const std::exception &e)
+    {
+        v->error = e.what();
+        return -1;
+    }
+}
+
+int vcpu_load(vcpu *v, uint16_t addr, const uint8_t *data, size_t size)
+{
+    if (size_t(addr) + size > VCPU_MEMORY_SIZE)
+    {
+        v->error = "Load past end of memory";
+        return -1;
+    }
+    for (size_t i = 0; i < size; i++)
+        *v->cpu.host_ptr(uint16_t(addr + i)) = data[i];
+    return 0;
+}
+
+void vcpu_reset(vcpu *v, uint16_t pc)
+{
+    v->cpu.reset(pc);
+}
+
+int vcpu_run(vcpu *v, uint64_t cycles)
+{
+    CPU &cpu = v->cpu;
+    cpu.resume();
+    cpu.ras_top = 0; // the host may have written the stack page through vcpu_memory()
+    return cpu.run_until(CycleBudget(cycles)) == RUN_HALT ? int(cpu.stop) : int(VCPU_STOP_NONE);
+}
+
+int vcpu_step(vcpu *v)
+{
+    CPU &cpu = v->cpu;
+    cpu.resume();
+    cpu.ras_top = 0; // the host may have written the stack page through vcpu_memory()
+    return cpu.run_until(InstructionBudget(1)) == RUN_HALT ? int(cpu.stop) : int(VCPU_STOP_NONE);
+}
+
+uint64_t vcpu_clock(const vcpu *v)
+{
+    return v->cpu.clock;
+}
+
+uint16_t vcpu_get_reg(const vcpu *v, int reg)
+{
+    const CPU &cpu = v->cpu;
+    switch (reg)
+    {
+    case VCPU_REG_A:
+        return cpu.A;
+    case VCPU_REG_X:
+        return cpu.X;
+    case VCPU_REG_SP:
+        return cpu.SP;
+    case VCPU_REG_P:
+        return cpu.P;
+    case VCPU_REG_PC:
+        return cpu.PC;
+    default:
+        return 0;
+    }
+}
+
+void vcpu_set_reg(vcpu *v, int reg, uint16_t value)
+{
+    CPU &cpu = v->cpu;
+    switch (reg)
+    {
+    case VCPU_REG_A:
+        cpu.A = uint8_t(value);
+        break;
+    case VCPU_REG_X:
+        cpu.X = uint8_t(value);
+        break;
+    case VCPU_REG_SP:
+        cpu.SP = uint8_t(value);
+        cpu.ras_top = 0; // shadow stack no longer matches
+        break;
+    case VCPU_REG_P:
+        cpu.P = uint8_t(value);
+        break;
+    case VCPU_REG_PC:
+        cpu.PC = value;
+        break;
+    }
+}
+
+uint8_t *vcpu_memory(vcpu *v)
+{
+    return v->cpu.mem;
+}
+
+void vcpu_set_breakpoint(vcpu *v, uint16_t addr, int on)
+{
+    v->cpu.set_breakpoint(addr, on != 0);
+}
+
+void vcpu_set_watchpoint(vcpu *v, uint16_t addr, int on_read, int on_write)
+{
+    v->cpu.set_watchpoint(addr, on_read != 0, on_write != 0);
+}
+
+void vcpu_set_stack_checked(vcpu *v, int on)
+{
+    v->cpu.set_stack_checked(on != 0);
+}
@@ -0,0 +1,125 @@
+#!/usr/bin/env python3
+"""Python bindings for libvcpu (include/vcpu.h).
+
+    from vcpu import Vcpu
+    cpu = Vcpu()
+    cpu.load_rom(open('code.rom', 'rb').read())
+    stop = cpu.run(1_000_000)
+    print(cpu.a, cpu.x, cpu.mem[0x1000])
+
+`Vcpu.mem` is a writable memoryview over guest memory; nothing is copied.
+The library is looked up in $VCPU_LIB, then next to this file.
+"""
+import ctypes
+import os
+import sys
+
+# ---------- Library ----------
+
+def _lib_path():
+    if os.environ.get('VCPU_LIB'):
+        return os.environ['VCPU_LIB']
+    name = {'win32': 'vcpu.dll', 'darwin': 'libvcpu.dylib'}.get(sys.platform, 'libvcpu.so')
+    return os.path.join(os.path.dirname(os.path.abspath(__file__)), name)
+
+_lib = ctypes.CDLL(_lib_path())
+
+_vp = ctypes.c_void_p
+_u8p = ctypes.POINTER(ctypes.c_uint8)
+
+def _fn(name, restype, *argtypes):
+    f = getattr(_lib, name)
+    f.restype = restype
+    f.argtypes = argtypes
+    return f
+
+_create = _fn('vcpu_create', _vp)
+_destroy = _fn('vcpu_destroy', None, _vp)
+_last_error = _fn('vcpu_last_error', ctypes.c_char_p, _vp)
+_load_rom = _fn('vcpu_load_rom', ctypes.c_int, _vp, ctypes.c_char_p, ctypes.c_size_t)
+_load = _fn('vcpu_load', ctypes.c_int, _vp, ctypes.c_uint16, ctypes.c_char_p, ctypes.c_size_t)
+_reset = _fn('vcpu_reset', None, _vp, ctypes.c_uint16)
+_run = _fn('vcpu_run', ctypes.c_int, _vp, ctypes.c_uint64)
+_step = _fn('vcpu_step', ctypes.c_int, _vp)
+_clock = _fn('vcpu_clock', ctypes.c_uint64, _vp)
+_get_reg = _fn('vcpu_get_reg', ctypes.c_uint16, _vp, ctypes.c_int)
+_set_reg = _fn('vcpu_set_reg', None, _vp, ctypes.c_int, ctypes.c_uint16)
+_memory = _fn('vcpu_memory', _u8p, _vp)
+_set_breakpoint = _fn('vcpu_set_breakpoint', None, _vp, ctypes.c_uint16, ctypes.c_int)
+_set_watchpoint = _fn('vcpu_set_watchpoint', None, _vp, ctypes.c_uint16, ctypes.c_int, ctypes.c_int)
+_set_stack_checked = _fn('vcpu_set_stack_checked', None, _vp, ctypes.c_int)
+
+MEMORY_SIZE = 65536
+
+# ---------- Constants (match include/vcpu.h) ----------
+
+REG_A, REG_X, REG_SP, REG_P, REG_PC = range(5)
+STOP_NONE, STOP_HALT, STOP_FAULT, STOP_BREAKPOINT, STOP_WATCHPOINT = range(5)
+
+# ---------- CPU handle ----------
+
+def _reg(index):
+    return property(lambda self: _get_reg(self._h, index),
+                    lambda self, v: _set_reg(self._h, index, v))
+
+class Vcpu:
+    a = _reg(REG_A)
+    x = _reg(REG_X)
+    sp = _reg(REG_SP)
+    p = _reg(REG_P)
+    pc = _reg(REG_PC)
+
+    def __init__(self):
+        self._h = _create()
+        if not self._h:
+            raise MemoryError('vcpu_create failed')
+        buf = (ctypes.c_uint8 * MEMORY_SIZE).from_address(ctypes.addressof(_memory(self._h).contents))
+        self.mem = memoryview(buf).cast('B')
+
+    def close(self):
+        if self._h:
+            self.mem.release()
+            _destroy(self._h)
+            self._h = None
+
+    def __del__(self):
+        self.close()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def _check(self, rc):
+        if rc != 0:
+            raise RuntimeError(_last_error(self._h).decode())
+
+    def load_rom(self, image):
+        self._check(_load_rom(self._h, bytes(image), len(image)))
+
+    def load(self, addr, data):
+        self._check(_load(self._h, addr, bytes(data), len(data)))
+
+    def reset(self, pc):
+        _reset(self._h, pc)
+
+    def run(self, cycles):
+        """Runs up to `cycles` cycles; returns a STOP_* code."""
+        return _run(self._h, cycles)
+
+    def step(self):
+        return _step(self._h)
+
+    @property
+    def clock(self):
+        return _clock(self._h)
+
+    def set_breakpoint(self, addr, on=True):
+        _set_breakpoint(self._h, addr, int(on))
+
+    def set_watchpoint(self, addr, on_read=True, on_write=True):
+        _set_watchpoint(self._h, addr, int(on_read), int(on_write))
+
+    def set_stack_checked(self, on=True):
+        _set_stack_checked(self._h, int(on))